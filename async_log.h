@@ -0,0 +1,151 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "lap_events.h"
+#include "time_format.h"
+
+enum class LogEvent : std::uint8_t {
+    Started,
+    Resumed,
+    AlreadyRunning,
+    Stopped,
+    Paused,
+    AlreadyPaused,
+    NotRunning,
+    Lap,
+    LapRejected
+};
+
+// Fixed-size binary record; the caller only fills these fields, all text is
+// produced later on the writer thread.
+struct LogRecord {
+    double seconds;
+    std::uint32_t source;
+    std::uint32_t lap;
+    LogEvent event;
+};
+
+inline void format_log_record(const LogRecord& record, std::string& out, TimeFormat format = TimeFormat::MinutesSeconds) {
+    std::int64_t ns = seconds_to_ns(record.seconds);
+    switch (record.event) {
+        case LogEvent::Started:
+            out += "Stopwatch started.";
+            break;
+        case LogEvent::Resumed:
+            out += "Stopwatch resumed.";
+            break;
+        case LogEvent::AlreadyRunning:
+            out += "Stopwatch is already running.";
+            break;
+        case LogEvent::Stopped:
+            out += "Elapsed time: ";
+            append_duration(out, ns, format);
+            out += " (Stopwatch stopped)";
+            break;
+        case LogEvent::Paused:
+            out += "Elapsed time: ";
+            append_duration(out, ns, format);
+            out += " (Stopwatch paused)";
+            break;
+        case LogEvent::AlreadyPaused:
+            out += "Stopwatch is already paused.";
+            break;
+        case LogEvent::NotRunning:
+            out += "Stopwatch is not running.";
+            break;
+        case LogEvent::Lap:
+            out += "Lap ";
+            {
+                char buf[16];
+                out.append(buf, std::to_chars(buf, buf + sizeof(buf), record.lap).ptr);
+            }
+            out += ": Elapsed time: ";
+            append_duration(out, ns, format);
+            break;
+        case LogEvent::LapRejected:
+            out += "Cannot record lap: Stopwatch is not running.";
+            break;
+    }
+}
+
+// Nanolog-style writer: log() copies a LogRecord into a lock-free ring and
+// returns; a background thread wakes every flush_interval, formats everything
+// that accumulated into one buffer and issues a single write().
+class AsyncLog {
+private:
+    BoundedMpscQueue<LogRecord> queue;
+    int fd;
+    std::chrono::milliseconds flush_interval;
+    std::atomic<std::uint64_t> dropped{0};
+    std::atomic<bool> running{true};
+    std::atomic<TimeFormat> time_format{TimeFormat::MinutesSeconds};
+    std::thread writer;
+
+    void drain(std::vector<LogRecord>& batch, std::string& text) {
+        while (true) {
+            batch.clear();
+            if (queue.popBatch(batch, 4096) == 0) {
+                break;
+            }
+            text.clear();
+            TimeFormat format = time_format.load(std::memory_order_relaxed);
+            for (const LogRecord& record : batch) {
+                format_log_record(record, text, format);
+                text += '\n';
+            }
+            const char* data = text.data();
+            std::size_t remaining = text.size();
+            while (remaining > 0) {
+                ssize_t n = ::write(fd, data, remaining);
+                if (n <= 0) {
+                    break;
+                }
+                data += n;
+                remaining -= static_cast<std::size_t>(n);
+            }
+        }
+    }
+
+public:
+    explicit AsyncLog(int output_fd = STDOUT_FILENO, std::size_t capacity = 65536,
+                      std::chrono::milliseconds interval = std::chrono::milliseconds(10))
+        : queue(capacity), fd(output_fd), flush_interval(interval) {
+        writer = std::thread([this]() {
+            std::vector<LogRecord> batch;
+            batch.reserve(4096);
+            std::string text;
+            while (running.load(std::memory_order_acquire)) {
+                drain(batch, text);
+                std::this_thread::sleep_for(flush_interval);
+            }
+            drain(batch, text);
+        });
+    }
+
+    ~AsyncLog() {
+        running.store(false, std::memory_order_release);
+        writer.join();
+    }
+
+    AsyncLog(const AsyncLog&) = delete;
+    AsyncLog& operator=(const AsyncLog&) = delete;
+
+    void log(LogEvent event, std::uint32_t source, double seconds = 0.0, std::uint32_t lap = 0) {
+        if (!queue.tryPush({seconds, source, lap, event})) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void setTimeFormat(TimeFormat format) { time_format.store(format, std::memory_order_relaxed); }
+
+    std::uint64_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+};
@@ -0,0 +1,228 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "cpu_affinity.h"
+
+struct BenchCase {
+    std::string name;
+    std::function<void()> body;
+    std::size_t iterations = 1;
+    // Noise-sensitive cases are kept out of the pool and run one at a time
+    // after all parallel cases have finished.
+    bool serial = false;
+    // Work items processed per iteration, for throughput reporting.
+    std::size_t items = 0;
+};
+
+struct BenchResult {
+    std::string name;
+    int cpu = -1;
+    std::size_t iterations = 0;
+    std::size_t items = 0;
+    std::chrono::duration<double> total{0};
+    std::chrono::duration<double> min{0};
+    std::chrono::duration<double> max{0};
+
+    std::chrono::duration<double> mean() const {
+        return iterations ? total / static_cast<double>(iterations) : std::chrono::duration<double>(0);
+    }
+
+    double itemsPerSecond() const {
+        return total.count() > 0 ? static_cast<double>(items * iterations) / total.count() : 0.0;
+    }
+};
+
+// Chase-Lev deque over case indices. All pushes happen before the workers are
+// started, so the buffer never grows and needs no reclamation.
+class WorkStealingDeque {
+private:
+    std::vector<std::size_t> items;
+    alignas(64) std::atomic<std::int64_t> top{0};
+    alignas(64) std::atomic<std::int64_t> bottom{0};
+
+public:
+    explicit WorkStealingDeque(std::size_t capacity) : items(std::max<std::size_t>(capacity, 1)) {}
+
+    void push(std::size_t item) {
+        std::int64_t b = bottom.load(std::memory_order_relaxed);
+        items[static_cast<std::size_t>(b) % items.size()] = item;
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    bool pop(std::size_t& item) {
+        std::int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t t = top.load(std::memory_order_relaxed);
+        if (t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+        item = items[static_cast<std::size_t>(b) % items.size()];
+        if (t == b) {
+            bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    bool steal(std::size_t& item) {
+        std::int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b) {
+            return false;
+        }
+        item = items[static_cast<std::size_t>(t) % items.size()];
+        return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+};
+
+class BenchRunner {
+private:
+    std::vector<BenchCase> cases;
+    std::vector<int> allowed_cpus;
+    bool realtime = false;
+    std::string filter;
+
+    struct alignas(64) Worker {
+        int cpu = -1;
+        WorkStealingDeque deque;
+        std::vector<BenchResult> results;
+
+        explicit Worker(std::size_t capacity) : deque(capacity) { results.reserve(capacity); }
+    };
+
+    static BenchResult runCase(const BenchCase& c, int cpu) {
+        BenchResult result;
+        result.name = c.name;
+        result.cpu = cpu;
+        for (std::size_t i = 0; i < c.iterations; ++i) {
+            auto begin = std::chrono::steady_clock::now();
+            c.body();
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+            result.total += elapsed;
+            if (i == 0 || elapsed < result.min) result.min = elapsed;
+            if (i == 0 || elapsed > result.max) result.max = elapsed;
+        }
+        result.iterations = c.iterations;
+        result.items = c.items;
+        return result;
+    }
+
+public:
+    // Restricts workers to the given cores instead of the process affinity mask.
+    void setCpus(std::vector<int> cpus) {
+        allowed_cpus = std::move(cpus);
+    }
+
+    // Requests SCHED_FIFO for worker threads and for the calling thread while
+    // it runs the serial cases (its policy is restored afterwards); silently
+    // stays on the normal policy when the process is not permitted to use it.
+    void setRealtimePriority(bool enabled) {
+        realtime = enabled;
+    }
+
+    // Only cases whose name contains the given text are run.
+    void setFilter(std::string text) {
+        filter = std::move(text);
+    }
+
+    void add(BenchCase c) {
+        cases.push_back(std::move(c));
+    }
+
+    void add(std::string name, std::function<void()> body, std::size_t iterations = 1, bool serial = false, std::size_t items = 0) {
+        cases.push_back({std::move(name), std::move(body), iterations, serial, items});
+    }
+
+    // Runs parallel cases on at most one worker per available core, each worker
+    // pinned to its own core, then the serial cases on the calling thread.
+    // Passing workers == 1 runs everything serially.
+    std::vector<BenchResult> run(unsigned workers = std::thread::hardware_concurrency()) {
+        std::vector<int> cpus = allowed_cpus.empty() ? available_cpus() : allowed_cpus;
+        std::vector<int> previous_cpus = available_cpus();
+        if (!cpus.empty()) {
+            workers = std::min<unsigned>(workers, static_cast<unsigned>(cpus.size()));
+        }
+        workers = std::max(workers, 1u);
+
+        std::vector<std::size_t> parallel;
+        std::vector<std::size_t> serial;
+        for (std::size_t i = 0; i < cases.size(); ++i) {
+            if (!filter.empty() && cases[i].name.find(filter) == std::string::npos) {
+                continue;
+            }
+            (cases[i].serial || workers == 1 ? serial : parallel).push_back(i);
+        }
+
+        std::vector<BenchResult> results;
+        if (!parallel.empty()) {
+            std::vector<std::unique_ptr<Worker>> pool;
+            for (unsigned w = 0; w < workers; ++w) {
+                pool.push_back(std::make_unique<Worker>(parallel.size()));
+                pool.back()->cpu = cpus.empty() ? -1 : cpus[w];
+            }
+            for (std::size_t i = 0; i < parallel.size(); ++i) {
+                pool[i % workers]->deque.push(parallel[i]);
+            }
+
+            std::vector<std::thread> threads;
+            for (unsigned w = 0; w < workers; ++w) {
+                threads.emplace_back([this, &pool, w, workers]() {
+                    Worker& self = *pool[w];
+                    int cpu = pin_current_thread(self.cpu) ? self.cpu : -1;
+                    if (realtime) {
+                        raise_thread_priority();
+                    }
+                    std::size_t index;
+                    while (true) {
+                        bool found = self.deque.pop(index);
+                        for (unsigned v = 1; !found && v < workers; ++v) {
+                            found = pool[(w + v) % workers]->deque.steal(index);
+                        }
+                        if (!found) {
+                            break;
+                        }
+                        self.results.push_back(runCase(cases[index], cpu));
+                    }
+                });
+            }
+            for (auto& t : threads) {
+                t.join();
+            }
+            for (auto& worker : pool) {
+                results.insert(results.end(), worker->results.begin(), worker->results.end());
+            }
+        }
+
+        if (!serial.empty()) {
+            int cpu = cpus.empty() ? -1 : cpus.front();
+            bool pinned = pin_current_thread(cpu);
+            ThreadSchedule previous_schedule = current_thread_schedule();
+            bool raised = realtime && raise_thread_priority();
+            for (std::size_t index : serial) {
+                results.push_back(runCase(cases[index], pinned ? cpu : -1));
+            }
+            if (raised) {
+                restore_thread_schedule(previous_schedule);
+            }
+            if (pinned) {
+                pin_current_thread(previous_cpus);
+            }
+        }
+        return results;
+    }
+};
@@ -0,0 +1,337 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "metrics_wire.h"
+#include "stopwatch_clock.h"
+
+// Monotonic clocks in different processes (or, through a collector standing
+// in for a cross-node one, on different hosts) have unrelated origins and
+// drift apart at a few ppm. ClockSync measures a local clock domain against
+// the collector's clock the way NTP does: a burst of pings, each
+// timestamped on both sides, from which the offset between the clocks
+// follows to within half the round trip. Only the burst's fastest exchange
+// is kept, since queueing delay is what makes the two legs unequal, and the
+// skew is the slope of those offsets over the last WINDOW bursts.
+
+// One exchange: t1 and t4 on the local clock when the request left and the
+// reply arrived, t2 and t3 on the reference clock when the request arrived
+// and the reply left.
+struct ClockSyncSample {
+    std::int64_t t1 = 0;
+    std::int64_t t2 = 0;
+    std::int64_t t3 = 0;
+    std::int64_t t4 = 0;
+
+    // Reference minus local; exact when both legs took equally long.
+    std::int64_t offset() const { return ((t2 - t1) + (t3 - t4)) / 2; }
+    std::int64_t roundTrip() const { return (t4 - t1) - (t3 - t2); }
+    std::int64_t midpoint() const { return t1 + (t4 - t1) / 2; }
+};
+
+// Local readings of one clock domain mapped onto a reference clock:
+//   reference = local + offset_ns + skew * (local - local_ns)
+struct ClockMapping {
+    // Identifies the reference clock; mappings with different ids can't be
+    // compared. 0 until a sync has succeeded.
+    std::uint64_t reference_id = 0;
+    ClockDomain domain = ClockDomain::Monotonic;
+    std::int64_t local_ns = 0;
+    std::int64_t offset_ns = 0;
+    // Reference rate over local rate, minus one.
+    double skew = 0.0;
+    // Bound on the error at local_ns: half the best round trip plus the
+    // scatter of the offsets around the fit.
+    std::int64_t uncertainty_ns = 0;
+    std::uint32_t bursts = 0;
+
+    bool valid() const { return reference_id != 0; }
+
+    std::int64_t toReference(std::int64_t local) const {
+        return local + offset_ns + static_cast<std::int64_t>(std::llround(skew * static_cast<double>(local - local_ns)));
+    }
+};
+
+// Reference side: fills in a SyncReply for a SyncRequest body (the sender's
+// t1). received_ns is the reference clock read as the request came in; the
+// send time is read from now() last, just before the caller sends.
+template <typename Now>
+inline bool clock_sync_answer(const MetricsHeader& request, const std::uint8_t* p, const std::uint8_t* end,
+                              std::int64_t received_ns, std::uint64_t reference_id, std::string& reply, Now now) {
+    std::int64_t t1;
+    if (!metrics_wire::get_raw(p, end, t1)) {
+        return false;
+    }
+    reply.clear();
+    put_metrics_header(reply, MetricsMessage::SyncReply, 0, static_cast<std::uint32_t>(::getpid()), request.sequence);
+    metrics_wire::put_raw(reply, t1);
+    metrics_wire::put_raw(reply, received_ns);
+    metrics_wire::put_raw(reply, reference_id);
+    metrics_wire::put_raw(reply, static_cast<std::int64_t>(now()));
+    return true;
+}
+
+// Keeps the fastest exchange of each burst and fits offset and skew to them.
+class ClockSyncEstimator {
+public:
+    static constexpr std::size_t WINDOW = 16;
+    // Below this spread of burst times, a slope would mostly be noise.
+    static constexpr std::int64_t MIN_SKEW_SPAN_NS = 1000000000;
+    static constexpr double MAX_SKEW = 500e-6;
+
+private:
+    struct Point {
+        std::int64_t local_ns;
+        std::int64_t offset_ns;
+        std::int64_t round_trip_ns;
+    };
+
+    std::deque<Point> points;
+
+public:
+    void addBurst(const ClockSyncSample* samples, std::size_t count) {
+        const ClockSyncSample* best = nullptr;
+        for (std::size_t i = 0; i < count; ++i) {
+            if (samples[i].roundTrip() >= 0 && (!best || samples[i].roundTrip() < best->roundTrip())) {
+                best = &samples[i];
+            }
+        }
+        if (!best) {
+            return;
+        }
+        points.push_back({best->midpoint(), best->offset(), best->roundTrip()});
+        if (points.size() > WINDOW) {
+            points.pop_front();
+        }
+    }
+
+    // Pivots on the newest burst. Bursts whose best round trip was more
+    // than twice the window's best (a busy moment on either side) are left
+    // out of the fit.
+    ClockMapping estimate(std::uint64_t reference_id, ClockDomain domain) const {
+        ClockMapping mapping;
+        if (points.empty()) {
+            return mapping;
+        }
+        std::int64_t best_rtt = points.front().round_trip_ns;
+        for (const Point& p : points) {
+            best_rtt = std::min(best_rtt, p.round_trip_ns);
+        }
+        std::vector<Point> used;
+        for (const Point& p : points) {
+            if (p.round_trip_ns <= 2 * best_rtt + 1000) {
+                used.push_back(p);
+            }
+        }
+        // Sums relative to the pivot keep the doubles well within precision.
+        const Point& pivot = used.back();
+        double n = static_cast<double>(used.size());
+        double mean_x = 0.0, mean_y = 0.0;
+        for (const Point& p : used) {
+            mean_x += static_cast<double>(p.local_ns - pivot.local_ns) / n;
+            mean_y += static_cast<double>(p.offset_ns - pivot.offset_ns) / n;
+        }
+        double sxx = 0.0, sxy = 0.0;
+        for (const Point& p : used) {
+            double dx = static_cast<double>(p.local_ns - pivot.local_ns) - mean_x;
+            sxx += dx * dx;
+            sxy += dx * (static_cast<double>(p.offset_ns - pivot.offset_ns) - mean_y);
+        }
+        double span = static_cast<double>(pivot.local_ns - used.front().local_ns);
+        double skew = used.size() >= 2 && span >= MIN_SKEW_SPAN_NS ? std::clamp(sxy / sxx, -MAX_SKEW, MAX_SKEW) : 0.0;
+        // The fitted offset at the pivot.
+        double at_pivot = used.size() >= 2 ? mean_y - skew * mean_x : 0.0;
+        double residual = 0.0;
+        for (const Point& p : used) {
+            double fit = at_pivot + skew * static_cast<double>(p.local_ns - pivot.local_ns);
+            double d = static_cast<double>(p.offset_ns - pivot.offset_ns) - fit;
+            residual += d * d / n;
+        }
+
+        mapping.reference_id = reference_id;
+        mapping.domain = domain;
+        mapping.local_ns = pivot.local_ns;
+        mapping.offset_ns = pivot.offset_ns + std::llround(at_pivot);
+        mapping.skew = skew;
+        mapping.uncertainty_ns = best_rtt / 2 + std::llround(std::sqrt(residual));
+        mapping.bursts = static_cast<std::uint32_t>(used.size());
+        return mapping;
+    }
+
+    void clear() { points.clear(); }
+};
+
+// Keeps a mapping from a local clock domain to the collector's clock
+// current: a burst of PINGS exchanges right away and then every interval.
+// mapping() may be read from any thread; generation() changes whenever it
+// does, so a reader can cheaply tell it has a newer one.
+class ClockSync {
+public:
+    static constexpr unsigned PINGS = 8;
+
+private:
+    int fd = -1;
+    sockaddr_un address{};
+    socklen_t address_length = 0;
+    ClockDomain local_domain;
+    std::chrono::milliseconds sync_interval;
+    std::uint32_t sequence = 0;
+
+    // Held through a burst so syncNow() and the thread don't interleave.
+    std::mutex burst_mtx;
+    ClockSyncEstimator estimator;
+    mutable std::mutex mapping_mtx;
+    ClockMapping current;
+    std::atomic<std::uint64_t> changes{0};
+    std::atomic<std::uint64_t> failures{0};
+
+    std::mutex wake_mtx;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::thread syncer;
+
+    std::int64_t localNs() const { return clock_detail::read_ns(clock_detail::clock_id(local_domain)); }
+
+    // One exchange; false on timeout. Replies to earlier, timed-out pings
+    // are skipped by their sequence number.
+    bool ping(ClockSyncSample& sample, std::uint64_t& reference_id) {
+        std::uint32_t number = sequence++;
+        std::string request;
+        put_metrics_header(request, MetricsMessage::SyncRequest, 0, static_cast<std::uint32_t>(::getpid()), number);
+        sample.t1 = localNs();
+        metrics_wire::put_raw(request, sample.t1);
+        if (::sendto(fd, request.data(), request.size(), MSG_NOSIGNAL, reinterpret_cast<const sockaddr*>(&address),
+                     address_length) != static_cast<ssize_t>(request.size())) {
+            return false;
+        }
+        std::uint8_t reply[64];
+        while (true) {
+            ssize_t n = ::recv(fd, reply, sizeof(reply), 0);
+            std::int64_t t4 = localNs();
+            if (n < 0) {
+                return false;
+            }
+            const std::uint8_t* p = reply;
+            const std::uint8_t* end = reply + n;
+            MetricsHeader header;
+            std::int64_t t1;
+            if (!read_metrics_header(p, end, header) || header.type != MetricsMessage::SyncReply ||
+                header.sequence != number || !metrics_wire::get_raw(p, end, t1) || t1 != sample.t1 ||
+                !metrics_wire::get_raw(p, end, sample.t2) || !metrics_wire::get_raw(p, end, reference_id) ||
+                !metrics_wire::get_raw(p, end, sample.t3)) {
+                continue;
+            }
+            sample.t4 = t4;
+            return true;
+        }
+    }
+
+public:
+    explicit ClockSync(const std::string& socket_path = METRICS_DEFAULT_SOCKET,
+                       ClockDomain domain = ClockDomain::Monotonic,
+                       std::chrono::milliseconds interval = std::chrono::seconds(10))
+        : local_domain(domain), sync_interval(interval) {
+        if (socket_path.size() >= sizeof(address.sun_path)) {
+            throw std::runtime_error("Collector socket path is too long");
+        }
+        fd = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            throw std::runtime_error(std::string("Unable to create clock sync socket: ") + std::strerror(errno));
+        }
+        // Autobind to an abstract address so the collector can reply.
+        sa_family_t family = AF_UNIX;
+        if (::bind(fd, reinterpret_cast<const sockaddr*>(&family), sizeof(family)) != 0) {
+            ::close(fd);
+            throw std::runtime_error(std::string("Unable to bind clock sync socket: ") + std::strerror(errno));
+        }
+        timeval timeout{0, 100000};
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+        address_length = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + socket_path.size() + 1);
+        // The first burst runs here, so laps recorded right after
+        // construction already have a mapping (if the collector answered).
+        syncNow();
+        syncer = std::thread([this]() {
+            std::unique_lock<std::mutex> lock(wake_mtx);
+            while (!wake.wait_for(lock, sync_interval, [this]() { return stopping; })) {
+                lock.unlock();
+                syncNow();
+                lock.lock();
+            }
+        });
+    }
+
+    ~ClockSync() {
+        {
+            std::lock_guard<std::mutex> lock(wake_mtx);
+            stopping = true;
+        }
+        wake.notify_all();
+        syncer.join();
+        ::close(fd);
+    }
+
+    ClockSync(const ClockSync&) = delete;
+    ClockSync& operator=(const ClockSync&) = delete;
+
+    // Runs one burst and updates the mapping; false if no ping was answered.
+    // A new reference id (the collector restarted) starts the fit over.
+    bool syncNow() {
+        std::lock_guard<std::mutex> burst(burst_mtx);
+        ClockSyncSample samples[PINGS];
+        std::size_t answered = 0;
+        std::uint64_t reference_id = 0;
+        for (unsigned i = 0; i < PINGS; ++i) {
+            ClockSyncSample sample;
+            std::uint64_t id;
+            if (!ping(sample, id)) {
+                continue;
+            }
+            if (id != reference_id) {
+                answered = 0;
+                reference_id = id;
+            }
+            samples[answered++] = sample;
+        }
+        if (answered == 0) {
+            failures.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(mapping_mtx);
+        if (reference_id != current.reference_id) {
+            estimator.clear();
+        }
+        estimator.addBurst(samples, answered);
+        current = estimator.estimate(reference_id, local_domain);
+        changes.fetch_add(1, std::memory_order_release);
+        return true;
+    }
+
+    ClockMapping mapping() const {
+        std::lock_guard<std::mutex> lock(mapping_mtx);
+        return current;
+    }
+
+    std::uint64_t generation() const { return changes.load(std::memory_order_acquire); }
+    std::uint64_t failedCount() const { return failures.load(std::memory_order_relaxed); }
+    ClockDomain domain() const { return local_domain; }
+};
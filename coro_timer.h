@@ -0,0 +1,248 @@
+#pragma once
+
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+// Times a coroutine by its on-CPU activity rather than wall time: every
+// co_await that actually suspends closes an active interval and opens a
+// suspended one, which the matching resumption closes again. Nothing is
+// counted before begin() or after finish().
+struct CoroutineTiming {
+    std::chrono::nanoseconds active{0};
+    std::chrono::nanoseconds suspended{0};
+    std::uint64_t resumes = 0;
+};
+
+class CoroutineTimer {
+private:
+    using clock = std::chrono::steady_clock;
+
+    clock::time_point mark;
+    CoroutineTiming totals;
+    bool is_started = false;
+    bool is_active = false;
+    bool is_finished = false;
+
+public:
+    // A timer used with timed() inside a running coroutine starts right
+    // away; promise-owned timers start from the initial suspend instead.
+    explicit CoroutineTimer(bool start_now = true) {
+        if (start_now) {
+            begin();
+        }
+    }
+
+    void begin() {
+        mark = clock::now();
+        is_started = true;
+        is_active = true;
+        is_finished = false;
+    }
+
+    void suspend() {
+        if (!is_started) {
+            return;
+        }
+        auto now = clock::now();
+        if (is_active) {
+            totals.active += now - mark;
+            is_active = false;
+        }
+        mark = now;
+    }
+
+    void resume() {
+        if (!is_started) {
+            return;
+        }
+        auto now = clock::now();
+        if (!is_active) {
+            totals.suspended += now - mark;
+            ++totals.resumes;
+            is_active = true;
+        }
+        mark = now;
+    }
+
+    // Undoes suspend() when await_suspend() declined to suspend: the time in
+    // between was spent running, and nothing was resumed.
+    void proceed() {
+        if (!is_started) {
+            return;
+        }
+        auto now = clock::now();
+        if (!is_active) {
+            totals.active += now - mark;
+            is_active = true;
+        }
+        mark = now;
+    }
+
+    void finish() {
+        if (is_started && !is_finished) {
+            suspend();
+            is_finished = true;
+        }
+    }
+
+    CoroutineTiming timing() const {
+        CoroutineTiming current = totals;
+        if (is_started && !is_finished) {
+            auto open = clock::now() - mark;
+            if (is_active) {
+                current.active += open;
+            } else {
+                current.suspended += open;
+            }
+        }
+        return current;
+    }
+};
+
+namespace coro_timer_detail {
+
+template <typename T, typename = void>
+struct has_member_co_await : std::false_type {};
+
+template <typename T>
+struct has_member_co_await<T, std::void_t<decltype(std::declval<T>().operator co_await())>> : std::true_type {};
+
+template <typename T, typename = void>
+struct has_free_co_await : std::false_type {};
+
+template <typename T>
+struct has_free_co_await<T, std::void_t<decltype(operator co_await(std::declval<T>()))>> : std::true_type {};
+
+template <typename T>
+decltype(auto) get_awaiter(T&& awaitable) {
+    if constexpr (has_member_co_await<T>::value) {
+        return std::forward<T>(awaitable).operator co_await();
+    } else if constexpr (has_free_co_await<T>::value) {
+        return operator co_await(std::forward<T>(awaitable));
+    } else {
+        return std::forward<T>(awaitable);
+    }
+}
+
+}
+
+// Wraps any awaiter; await_ready() short-circuits without touching the clock,
+// so only real suspensions pay for the two clock reads.
+template <typename Awaiter>
+class TimedAwaiter {
+private:
+    Awaiter inner;
+    CoroutineTimer* timer;
+
+public:
+    TimedAwaiter(Awaiter&& awaiter, CoroutineTimer& t) : inner(std::forward<Awaiter>(awaiter)), timer(&t) {}
+
+    bool await_ready() { return inner.await_ready(); }
+
+    template <typename Promise>
+    auto await_suspend(std::coroutine_handle<Promise> handle) {
+        timer->suspend();
+        using result_type = decltype(inner.await_suspend(handle));
+        if constexpr (std::is_same_v<result_type, bool>) {
+            bool suspended = inner.await_suspend(handle);
+            if (!suspended) {
+                timer->proceed();
+            }
+            return suspended;
+        } else {
+            return inner.await_suspend(handle);
+        }
+    }
+
+    decltype(auto) await_resume() {
+        timer->resume();
+        return inner.await_resume();
+    }
+};
+
+template <typename Awaitable>
+auto timed(CoroutineTimer& timer, Awaitable&& awaitable) {
+    using result_type = decltype(coro_timer_detail::get_awaiter(std::forward<Awaitable>(awaitable)));
+    using awaiter_type = std::conditional_t<std::is_lvalue_reference_v<result_type>, result_type, std::remove_cvref_t<result_type>>;
+    return TimedAwaiter<awaiter_type>(coro_timer_detail::get_awaiter(std::forward<Awaitable>(awaitable)), timer);
+}
+
+// Wraps a promise's initial_suspend() awaiter: the timer starts when the
+// body first runs, so a lazy coroutine's wait to be scheduled isn't counted.
+template <typename Awaiter>
+class TimedStart {
+private:
+    Awaiter inner;
+    CoroutineTimer* timer;
+
+public:
+    TimedStart(Awaiter awaiter, CoroutineTimer& t) : inner(std::move(awaiter)), timer(&t) {}
+
+    bool await_ready() noexcept(noexcept(inner.await_ready())) { return inner.await_ready(); }
+
+    template <typename Promise>
+    auto await_suspend(std::coroutine_handle<Promise> handle) noexcept(noexcept(inner.await_suspend(handle))) {
+        return inner.await_suspend(handle);
+    }
+
+    decltype(auto) await_resume() {
+        timer->begin();
+        return inner.await_resume();
+    }
+};
+
+// Wraps a promise's final_suspend() awaiter: the timer stops as the body
+// completes, before any final suspension.
+template <typename Awaiter>
+class TimedFinish {
+private:
+    Awaiter inner;
+    CoroutineTimer* timer;
+
+public:
+    TimedFinish(Awaiter awaiter, CoroutineTimer& t) noexcept : inner(std::move(awaiter)), timer(&t) {}
+
+    bool await_ready() noexcept {
+        timer->finish();
+        return inner.await_ready();
+    }
+
+    template <typename Promise>
+    auto await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+        return inner.await_suspend(handle);
+    }
+
+    decltype(auto) await_resume() noexcept { return inner.await_resume(); }
+};
+
+// Promise-type mixin: derive a promise from TimedPromise and every co_await in
+// the coroutine body is timed without wrapping each call site. The defaults
+// make the coroutine lazy; a promise that overrides initial_suspend() or
+// final_suspend() should pass its awaiter through timedStart()/timedFinish().
+class TimedPromise {
+public:
+    CoroutineTimer coro_timer{false};
+
+    TimedStart<std::suspend_always> initial_suspend() { return timedStart(std::suspend_always{}); }
+    TimedFinish<std::suspend_always> final_suspend() noexcept { return timedFinish(std::suspend_always{}); }
+
+    template <typename Awaiter>
+    TimedStart<Awaiter> timedStart(Awaiter awaiter) {
+        return TimedStart<Awaiter>(std::move(awaiter), coro_timer);
+    }
+
+    template <typename Awaiter>
+    TimedFinish<Awaiter> timedFinish(Awaiter awaiter) noexcept {
+        return TimedFinish<Awaiter>(std::move(awaiter), coro_timer);
+    }
+
+    template <typename Awaitable>
+    auto await_transform(Awaitable&& awaitable) {
+        return timed(coro_timer, std::forward<Awaitable>(awaitable));
+    }
+
+    CoroutineTiming timing() const { return coro_timer.timing(); }
+};
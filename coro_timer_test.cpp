@@ -0,0 +1,183 @@
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "coro_timer.h"
+
+// Checks what CoroutineTimer counts as active and suspended time for a lazy
+// coroutine whose promise derives from TimedPromise: the wait before its
+// first resume and the time after it completes must count as neither.
+// Durations come from sleeps and busy loops, so the bounds are loose enough
+// for a loaded machine but far tighter than the gaps that must be excluded.
+//
+// g++ -std=c++20 -O2 coro_timer_test.cpp -o coro_timer_test
+
+namespace {
+
+using namespace std::chrono_literals;
+using clock_type = std::chrono::steady_clock;
+
+const auto GAP = 200ms;
+const auto WORK = 20ms;
+const auto SLACK = 50ms;
+
+struct Failure {
+    std::string what;
+};
+
+std::string ms(std::chrono::nanoseconds d) {
+    return std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(d).count()) + " ms";
+}
+
+void expect(bool ok, const std::string& what) {
+    if (!ok) {
+        throw Failure{what};
+    }
+}
+
+void busy(std::chrono::nanoseconds d) {
+    auto end = clock_type::now() + d;
+    while (clock_type::now() < end) {
+    }
+}
+
+// Suspends and hands the handle to the test, which resumes it later.
+struct Parked {
+    std::coroutine_handle<>* slot;
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle) const noexcept { *slot = handle; }
+    void await_resume() const noexcept {}
+};
+
+// A bool await_suspend that declines to suspend.
+struct Declined {
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<>) const noexcept { return false; }
+    void await_resume() const noexcept {}
+};
+
+struct Task {
+    struct promise_type : TimedPromise {
+        Task get_return_object() { return Task{std::coroutine_handle<promise_type>::from_promise(*this)}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    std::coroutine_handle<promise_type> handle;
+
+    explicit Task(std::coroutine_handle<promise_type> h) : handle(h) {}
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task() { handle.destroy(); }
+
+    CoroutineTiming timing() const { return handle.promise().timing(); }
+};
+
+// An eager variant: its initial_suspend goes through timedStart().
+struct EagerTask {
+    struct promise_type : TimedPromise {
+        EagerTask get_return_object() { return EagerTask{std::coroutine_handle<promise_type>::from_promise(*this)}; }
+        TimedStart<std::suspend_never> initial_suspend() { return timedStart(std::suspend_never{}); }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    std::coroutine_handle<promise_type> handle;
+
+    explicit EagerTask(std::coroutine_handle<promise_type> h) : handle(h) {}
+    EagerTask(const EagerTask&) = delete;
+    EagerTask& operator=(const EagerTask&) = delete;
+    ~EagerTask() { handle.destroy(); }
+
+    CoroutineTiming timing() const { return handle.promise().timing(); }
+};
+
+Task parked_once(std::coroutine_handle<>* slot) {
+    busy(WORK);
+    co_await Parked{slot};
+    busy(WORK);
+}
+
+Task never_suspends() {
+    co_await std::suspend_never{};
+    co_await Declined{};
+    busy(WORK);
+}
+
+EagerTask eager_parked(std::coroutine_handle<>* slot) {
+    busy(WORK);
+    co_await Parked{slot};
+}
+
+// Lazy start, one real suspension, then a long gap after completion.
+void lazy_task() {
+    std::coroutine_handle<> parked;
+    Task task = parked_once(&parked);
+    std::this_thread::sleep_for(GAP);
+    CoroutineTiming before = task.timing();
+    expect(before.active == 0ns && before.suspended == 0ns, "lazy task: time counted before its first resume");
+
+    task.handle.resume();
+    expect(parked && !task.handle.done(), "lazy task: did not park at its co_await");
+    std::this_thread::sleep_for(GAP);
+    CoroutineTiming mid = task.timing();
+    expect(mid.suspended >= GAP, "lazy task: suspended " + ms(mid.suspended) + " while parked for " + ms(GAP));
+
+    parked.resume();
+    expect(task.handle.done(), "lazy task: did not finish");
+    CoroutineTiming done = task.timing();
+    std::this_thread::sleep_for(GAP);
+    CoroutineTiming after = task.timing();
+    expect(after.active == done.active && after.suspended == done.suspended,
+           "lazy task: time kept accumulating after completion");
+    expect(after.resumes == 1, "lazy task: " + std::to_string(after.resumes) + " resumes, expected 1");
+    expect(after.active >= 2 * WORK && after.active < 2 * WORK + SLACK,
+           "lazy task: active " + ms(after.active) + ", expected about " + ms(2 * WORK));
+    expect(after.suspended >= GAP && after.suspended < GAP + SLACK,
+           "lazy task: suspended " + ms(after.suspended) + ", expected about " + ms(GAP));
+    std::cout << "lazy task: active " << ms(after.active) << ", suspended " << ms(after.suspended) << std::endl;
+}
+
+// Awaits that complete without suspending must not count as resumes.
+void ready_awaits() {
+    Task task = never_suspends();
+    task.handle.resume();
+    std::this_thread::sleep_for(GAP);
+    CoroutineTiming timing = task.timing();
+    expect(task.handle.done(), "ready awaits: did not finish");
+    expect(timing.resumes == 0 && timing.suspended < SLACK,
+           "ready awaits: " + std::to_string(timing.resumes) + " resumes, suspended " + ms(timing.suspended));
+    expect(timing.active >= WORK && timing.active < WORK + SLACK, "ready awaits: active " + ms(timing.active));
+}
+
+// An eager coroutine starts timing as soon as it is called.
+void eager_task() {
+    std::coroutine_handle<> parked;
+    EagerTask task = eager_parked(&parked);
+    expect(parked && !task.handle.done(), "eager task: did not run to its co_await");
+    std::this_thread::sleep_for(GAP);
+    parked.resume();
+    std::this_thread::sleep_for(GAP);
+    CoroutineTiming timing = task.timing();
+    expect(timing.active >= WORK && timing.active < WORK + SLACK, "eager task: active " + ms(timing.active));
+    expect(timing.suspended >= GAP && timing.suspended < GAP + SLACK, "eager task: suspended " + ms(timing.suspended));
+}
+
+}
+
+int main() {
+    try {
+        lazy_task();
+        ready_awaits();
+        eager_task();
+        std::cout << "coroutine timing: lazy, ready and eager cases match" << std::endl;
+    } catch (const Failure& f) {
+        std::cerr << "FAILED: " << f.what << std::endl;
+        return 1;
+    }
+    return 0;
+}
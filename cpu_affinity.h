@@ -0,0 +1,176 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+inline std::vector<int> available_cpus() {
+    std::vector<int> cpus;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+#endif
+    return cpus;
+}
+
+inline bool pin_current_thread(const std::vector<int>& cpus) {
+#ifdef __linux__
+    if (cpus.empty()) {
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    (void)cpus;
+    return false;
+#endif
+}
+
+inline bool pin_current_thread(int cpu) {
+    if (cpu < 0) {
+        return false;
+    }
+    return pin_current_thread(std::vector<int>{cpu});
+}
+
+// SCHED_FIFO needs CAP_SYS_NICE or an rtprio limit; without either the call
+// fails with EPERM and the thread keeps its normal policy.
+inline bool raise_thread_priority() {
+#ifdef __linux__
+    sched_param param{};
+    param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+    return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+#else
+    return false;
+#endif
+}
+
+// The calling thread's scheduling policy and priority, saved before
+// raise_thread_priority() so they can be put back afterwards.
+struct ThreadSchedule {
+    int policy = 0;
+    int priority = 0;
+};
+
+inline ThreadSchedule current_thread_schedule() {
+    ThreadSchedule schedule;
+#ifdef __linux__
+    sched_param param{};
+    if (pthread_getschedparam(pthread_self(), &schedule.policy, &param) == 0) {
+        schedule.priority = param.sched_priority;
+    }
+#endif
+    return schedule;
+}
+
+inline bool restore_thread_schedule(const ThreadSchedule& schedule) {
+#ifdef __linux__
+    sched_param param{};
+    param.sched_priority = schedule.priority;
+    return pthread_setschedparam(pthread_self(), schedule.policy, &param) == 0;
+#else
+    (void)schedule;
+    return false;
+#endif
+}
+
+inline int current_cpu() {
+#ifdef __linux__
+    return sched_getcpu();
+#else
+    return -1;
+#endif
+}
+
+// Current frequency of a core in kHz as reported by cpufreq, or 0 when the
+// platform does not expose it (VMs, containers without sysfs). The sysfs files
+// are opened once and re-read with pread so a snapshot is a single syscall.
+class CpuFrequency {
+private:
+    std::mutex mtx;
+    std::vector<int> fds;
+
+    int fileFor(int cpu) {
+#ifdef __linux__
+        std::lock_guard<std::mutex> lock(mtx);
+        if (static_cast<std::size_t>(cpu) >= fds.size()) {
+            fds.resize(cpu + 1, -2);
+        }
+        if (fds[cpu] == -2) {
+            std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/cpufreq/scaling_cur_freq";
+            fds[cpu] = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        }
+        return fds[cpu];
+#else
+        (void)cpu;
+        return -1;
+#endif
+    }
+
+public:
+    CpuFrequency() = default;
+    CpuFrequency(const CpuFrequency&) = delete;
+    CpuFrequency& operator=(const CpuFrequency&) = delete;
+
+    ~CpuFrequency() {
+#ifdef __linux__
+        for (int fd : fds) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+        }
+#endif
+    }
+
+    std::uint32_t khz(int cpu) {
+#ifdef __linux__
+        if (cpu < 0) {
+            return 0;
+        }
+        int fd = fileFor(cpu);
+        if (fd < 0) {
+            return 0;
+        }
+        char buf[32];
+        ssize_t n = ::pread(fd, buf, sizeof(buf) - 1, 0);
+        if (n <= 0) {
+            return 0;
+        }
+        std::uint32_t value = 0;
+        for (ssize_t i = 0; i < n && buf[i] >= '0' && buf[i] <= '9'; ++i) {
+            value = value * 10 + static_cast<std::uint32_t>(buf[i] - '0');
+        }
+        return value;
+#else
+        (void)cpu;
+        return 0;
+#endif
+    }
+
+    static CpuFrequency& instance() {
+        static CpuFrequency shared;
+        return shared;
+    }
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+// Schedules display frames on absolute deadlines and adapts to the cost of
+// producing them. The configured interval is the target; when rendering and
+// writing a frame takes long enough that the output can't keep up (a slow
+// terminal or a full pipe), the period is stretched so that output takes at
+// most 1/LOAD_FACTOR of the display thread's time. Deadlines that have
+// already passed are coalesced into the next frame and counted as dropped.
+class FramePacer {
+public:
+    using clock = std::chrono::steady_clock;
+    static constexpr double LOAD_FACTOR = 4.0;
+
+private:
+    clock::duration target;
+    double cost_ns = 0.0;
+    clock::time_point last_tick;
+    clock::time_point deadline;
+    std::uint64_t rendered = 0;
+    std::uint64_t dropped = 0;
+
+public:
+    explicit FramePacer(clock::duration interval, clock::time_point now = clock::now())
+        : target(interval), last_tick(now), deadline(now) {}
+
+    // Keeps the slot of the last frame, so a shorter interval fires early
+    // rather than waiting out the old one.
+    void setTarget(clock::duration interval) {
+        target = interval;
+        deadline = last_tick + period();
+    }
+
+    clock::duration period() const {
+        auto backoff = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double, std::nano>(cost_ns * LOAD_FACTOR));
+        return std::max(target, backoff);
+    }
+
+    void frameRendered(clock::duration cost) {
+        double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(cost).count());
+        cost_ns = rendered == 0 ? ns : cost_ns + (ns - cost_ns) / 8.0;
+        ++rendered;
+    }
+
+    void frameDropped() { ++dropped; }
+
+    // True while frames cost too much to be produced at the target rate.
+    bool overBudget() const { return period() > target; }
+
+    // Moves past the frame due at the current deadline and returns the next
+    // one.
+    clock::time_point advance(clock::time_point now) {
+        clock::duration step = period();
+        last_tick = deadline;
+        deadline += step;
+        if (deadline <= now) {
+            auto missed = (now - deadline) / step + 1;
+            dropped += static_cast<std::uint64_t>(missed);
+            deadline += missed * step;
+            last_tick = deadline - step;
+        }
+        return deadline;
+    }
+
+    clock::time_point nextDeadline() const { return deadline; }
+    std::uint64_t renderedFrames() const { return rendered; }
+    std::uint64_t droppedFrames() const { return dropped; }
+    double frameCostSeconds() const { return cost_ns * 1e-9; }
+};
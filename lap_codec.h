@@ -0,0 +1,262 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+struct JournalRecord {
+    std::int64_t elapsed_ns;
+    std::int32_t cpu;
+    std::uint32_t cpu_khz;
+};
+
+static_assert(sizeof(JournalRecord) == 16, "journal record layout is part of the file format");
+
+// LSB-first bit packing into 64-bit words. The writer always leaves eight
+// bytes of zero padding after the last word so the reader can use one
+// unaligned 64-bit load per field.
+class BitWriter {
+private:
+    std::uint8_t* out;
+    std::size_t bytes = 0;
+    std::uint64_t acc = 0;
+    unsigned fill = 0;
+
+    void store(std::uint64_t word) {
+        std::memcpy(out + bytes, &word, sizeof(word));
+        bytes += sizeof(word);
+    }
+
+public:
+    explicit BitWriter(std::uint8_t* buffer) : out(buffer) {}
+
+    void write(std::uint64_t value, unsigned count) {
+        if (count < 64) {
+            value &= (std::uint64_t(1) << count) - 1;
+        }
+        acc |= value << fill;
+        if (fill + count >= 64) {
+            store(acc);
+            acc = fill ? value >> (64 - fill) : 0;
+            fill = fill + count - 64;
+        } else {
+            fill += count;
+        }
+    }
+
+    std::size_t finish() {
+        std::size_t used = (fill + 7) / 8;
+        store(acc);
+        bytes -= sizeof(std::uint64_t) - used;
+        std::uint64_t zero = 0;
+        std::memcpy(out + bytes, &zero, sizeof(zero));
+        return bytes + sizeof(zero);
+    }
+};
+
+class BitReader {
+private:
+    const std::uint8_t* in;
+    std::size_t limit_bits;
+    std::size_t pos = 0;
+
+public:
+    BitReader(const std::uint8_t* buffer, std::size_t bytes) : in(buffer), limit_bits(bytes * 8) {}
+
+    // count <= 57. Past the end of the stream the load stays on the zero
+    // padding and reads 0, so a corrupt segment can't walk off the buffer;
+    // exhausted() then tells the caller the stream was overrun.
+    std::uint64_t read(unsigned count) {
+        std::size_t at = std::min(pos, limit_bits);
+        std::uint64_t word;
+        std::memcpy(&word, in + (at >> 3), sizeof(word));
+        word >>= at & 7;
+        pos += count;
+        return count ? word & ((std::uint64_t(1) << count) - 1) : 0;
+    }
+
+    std::uint64_t read64() {
+        std::uint64_t low = read(32);
+        return low | (read(32) << 32);
+    }
+
+    bool exhausted() const { return pos > limit_bits; }
+};
+
+// Gorilla-style XOR compression for 64-bit values: an unchanged value costs
+// one bit, a change that fits the previous meaningful-bit window costs two
+// bits plus the window, anything else stores a new window.
+class XorEncoder {
+private:
+    std::uint64_t previous = 0;
+    unsigned leading = 65;
+    unsigned trailing = 0;
+
+public:
+    void encode(BitWriter& out, std::uint64_t value) {
+        std::uint64_t x = value ^ previous;
+        previous = value;
+        if (x == 0) {
+            out.write(0, 1);
+            return;
+        }
+        unsigned lz = static_cast<unsigned>(std::countl_zero(x));
+        unsigned tz = static_cast<unsigned>(std::countr_zero(x));
+        if (lz > 31) {
+            lz = 31;
+        }
+        if (leading <= 64 && lz >= leading && tz >= trailing) {
+            out.write(0b01, 2);
+            out.write(x >> trailing, 64 - leading - trailing);
+            return;
+        }
+        leading = lz;
+        trailing = tz;
+        unsigned meaningful = 64 - lz - tz;
+        out.write(0b11, 2);
+        out.write(lz, 5);
+        out.write(meaningful - 1, 6);
+        out.write(x >> tz, meaningful);
+    }
+};
+
+class XorDecoder {
+private:
+    std::uint64_t previous = 0;
+    unsigned leading = 0;
+    unsigned trailing = 0;
+
+    std::uint64_t readBits(BitReader& in, unsigned count) {
+        if (count <= 57) {
+            return in.read(count);
+        }
+        std::uint64_t low = in.read(32);
+        return low | (in.read(count - 32) << 32);
+    }
+
+public:
+    std::uint64_t decode(BitReader& in) {
+        if (in.read(1) == 0) {
+            return previous;
+        }
+        if (in.read(1) == 1) {
+            leading = static_cast<unsigned>(in.read(5));
+            unsigned meaningful = static_cast<unsigned>(in.read(6)) + 1;
+            if (leading + meaningful > 64) {
+                throw std::runtime_error("Corrupt XOR window");
+            }
+            trailing = 64 - leading - meaningful;
+        }
+        unsigned meaningful = 64 - leading - trailing;
+        previous ^= readBits(in, meaningful) << trailing;
+        return previous;
+    }
+};
+
+// Lap stream layout: elapsed_ns as delta-of-delta with zigzag buckets sized
+// for nanosecond jitter, cpu as "same as before" or a 16-bit id, and cpu_khz
+// through the XOR scheme above. Worst case is well under 24 bytes a record.
+constexpr std::size_t LAP_CODEC_MAX_RECORD_BYTES = 24;
+
+inline std::size_t lap_codec_max_encoded_size(std::size_t count) {
+    return count * LAP_CODEC_MAX_RECORD_BYTES + 2 * sizeof(std::uint64_t);
+}
+
+// Every record takes at least three bits (unchanged delta, cpu and
+// frequency), which bounds the count a payload can hold.
+inline std::size_t lap_codec_max_records(std::size_t bytes) {
+    return bytes < sizeof(std::uint64_t) ? 0 : (bytes - sizeof(std::uint64_t)) * 8 / 3;
+}
+
+inline std::uint64_t zigzag(std::int64_t v) {
+    return (static_cast<std::uint64_t>(v) << 1) ^ static_cast<std::uint64_t>(v >> 63);
+}
+
+inline std::int64_t unzigzag(std::uint64_t v) {
+    return static_cast<std::int64_t>(v >> 1) ^ -static_cast<std::int64_t>(v & 1);
+}
+
+inline std::size_t encode_laps(const JournalRecord* records, std::size_t count, std::uint8_t* out) {
+    BitWriter writer(out);
+    XorEncoder khz;
+    std::int64_t previous = 0;
+    std::int64_t previous_delta = 0;
+    std::int32_t previous_cpu = -1;
+    for (std::size_t i = 0; i < count; ++i) {
+        const JournalRecord& r = records[i];
+        std::int64_t delta = r.elapsed_ns - previous;
+        std::uint64_t dod = zigzag(delta - previous_delta);
+        previous = r.elapsed_ns;
+        previous_delta = delta;
+
+        if (dod == 0) {
+            writer.write(0b0, 1);
+        } else if (dod < (1u << 7)) {
+            writer.write(0b01, 2);
+            writer.write(dod, 7);
+        } else if (dod < (1u << 12)) {
+            writer.write(0b011, 3);
+            writer.write(dod, 12);
+        } else if (dod < (1u << 20)) {
+            writer.write(0b0111, 4);
+            writer.write(dod, 20);
+        } else {
+            writer.write(0b1111, 4);
+            writer.write(dod, 64);
+        }
+
+        if (r.cpu == previous_cpu) {
+            writer.write(0, 1);
+        } else {
+            writer.write(1, 1);
+            writer.write(static_cast<std::uint16_t>(r.cpu + 1), 16);
+            previous_cpu = r.cpu;
+        }
+
+        khz.encode(writer, r.cpu_khz);
+    }
+    return writer.finish();
+}
+
+inline void decode_laps(const std::uint8_t* in, std::size_t bytes, std::size_t count, JournalRecord* out) {
+    if (bytes < sizeof(std::uint64_t)) {
+        throw std::runtime_error("Truncated lap segment");
+    }
+    if (count > lap_codec_max_records(bytes)) {
+        throw std::runtime_error("Corrupt lap segment");
+    }
+    BitReader reader(in, bytes - sizeof(std::uint64_t));
+    XorDecoder khz;
+    std::int64_t previous = 0;
+    std::int64_t previous_delta = 0;
+    std::int32_t cpu = -1;
+    for (std::size_t i = 0; i < count; ++i) {
+        std::uint64_t dod = 0;
+        if (reader.read(1) != 0) {
+            if (reader.read(1) == 0) {
+                dod = reader.read(7);
+            } else if (reader.read(1) == 0) {
+                dod = reader.read(12);
+            } else if (reader.read(1) == 0) {
+                dod = reader.read(20);
+            } else {
+                dod = reader.read64();
+            }
+        }
+        previous_delta += unzigzag(dod);
+        previous += previous_delta;
+
+        if (reader.read(1) != 0) {
+            cpu = static_cast<std::int32_t>(reader.read(16)) - 1;
+        }
+
+        out[i].elapsed_ns = previous;
+        out[i].cpu = cpu;
+        out[i].cpu_khz = static_cast<std::uint32_t>(khz.decode(reader));
+    }
+    if (reader.exhausted()) {
+        throw std::runtime_error("Corrupt lap segment");
+    }
+}
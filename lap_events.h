@@ -0,0 +1,190 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+struct LapEvent {
+    std::uint64_t source;
+    std::uint64_t lap;
+    std::chrono::nanoseconds elapsed;
+    int cpu;
+};
+
+// Bounded multi-producer/single-consumer ring (Vyukov). Each slot carries a
+// sequence number so producers claim slots with one CAS and never wait on the
+// consumer; a full ring is reported back to the caller instead of blocking.
+template <typename T>
+class BoundedMpscQueue {
+private:
+    struct Slot {
+        std::atomic<std::uint64_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    std::uint64_t mask;
+    alignas(64) std::atomic<std::uint64_t> head{0};
+    alignas(64) std::uint64_t tail = 0;
+
+public:
+    explicit BoundedMpscQueue(std::size_t capacity) {
+        std::size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        slots.reset(new Slot[size]);
+        mask = size - 1;
+        for (std::size_t i = 0; i < size; ++i) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool tryPush(const T& value) {
+        std::uint64_t pos = head.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = slots[pos & mask];
+            std::uint64_t seq = slot.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::int64_t>(seq - pos);
+            if (diff == 0) {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.value = value;
+                    slot.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Consumer only. Moves up to max items into out and returns the count.
+    std::size_t popBatch(std::vector<T>& out, std::size_t max) {
+        std::size_t count = 0;
+        while (count < max) {
+            Slot& slot = slots[tail & mask];
+            if (slot.sequence.load(std::memory_order_acquire) != tail + 1) {
+                break;
+            }
+            out.push_back(std::move(slot.value));
+            slot.sequence.store(tail + mask + 1, std::memory_order_release);
+            ++tail;
+            ++count;
+        }
+        return count;
+    }
+};
+
+enum class BackpressurePolicy {
+    Drop,
+    Wait
+};
+
+// Fans lap events out to subscribers from a dedicated consumer thread. The
+// publishing side is one slot claim plus, only when the consumer is parked,
+// a notify; formatting, I/O and subscriber callbacks never run inside lap().
+class LapEventBus {
+public:
+    using Subscriber = std::function<void(const LapEvent* events, std::size_t count)>;
+
+private:
+    BoundedMpscQueue<LapEvent> queue;
+    BackpressurePolicy policy;
+    std::size_t batch_size;
+    std::mutex subscribers_mtx;
+    std::vector<Subscriber> subscribers;
+    std::atomic<std::uint64_t> dropped{0};
+    std::atomic<std::uint64_t> delivered{0};
+    std::atomic<bool> running{true};
+    std::atomic<std::uint32_t> wakeups{0};
+    std::atomic<bool> consumer_parked{false};
+    std::thread consumer;
+
+    void wake() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (consumer_parked.load(std::memory_order_acquire)) {
+            wakeups.fetch_add(1, std::memory_order_release);
+            wakeups.notify_one();
+        }
+    }
+
+    void deliver(const std::vector<LapEvent>& batch) {
+        std::lock_guard<std::mutex> lock(subscribers_mtx);
+        for (const Subscriber& subscriber : subscribers) {
+            subscriber(batch.data(), batch.size());
+        }
+        delivered.fetch_add(batch.size(), std::memory_order_relaxed);
+    }
+
+    void run() {
+        std::vector<LapEvent> batch;
+        batch.reserve(batch_size);
+        while (true) {
+            batch.clear();
+            queue.popBatch(batch, batch_size);
+            if (!batch.empty()) {
+                deliver(batch);
+                continue;
+            }
+            if (!running.load(std::memory_order_acquire)) {
+                break;
+            }
+            std::uint32_t seen = wakeups.load(std::memory_order_acquire);
+            consumer_parked.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            batch.clear();
+            if (queue.popBatch(batch, batch_size) == 0 && running.load(std::memory_order_acquire)) {
+                wakeups.wait(seen, std::memory_order_acquire);
+            }
+            consumer_parked.store(false, std::memory_order_relaxed);
+            if (!batch.empty()) {
+                deliver(batch);
+            }
+        }
+    }
+
+public:
+    explicit LapEventBus(std::size_t capacity = 4096, BackpressurePolicy p = BackpressurePolicy::Drop, std::size_t batch = 256)
+        : queue(capacity), policy(p), batch_size(batch) {
+        consumer = std::thread([this]() { run(); });
+    }
+
+    ~LapEventBus() {
+        running.store(false, std::memory_order_release);
+        wakeups.fetch_add(1, std::memory_order_release);
+        wakeups.notify_one();
+        consumer.join();
+    }
+
+    LapEventBus(const LapEventBus&) = delete;
+    LapEventBus& operator=(const LapEventBus&) = delete;
+
+    void subscribe(Subscriber subscriber) {
+        std::lock_guard<std::mutex> lock(subscribers_mtx);
+        subscribers.push_back(std::move(subscriber));
+    }
+
+    bool publish(const LapEvent& event) {
+        while (!queue.tryPush(event)) {
+            if (policy == BackpressurePolicy::Drop) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            wake();
+            std::this_thread::yield();
+        }
+        wake();
+        return true;
+    }
+
+    std::uint64_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+    std::uint64_t deliveredCount() const { return delivered.load(std::memory_order_relaxed); }
+};
@@ -0,0 +1,608 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "lap_codec.h"
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <atomic>
+#include <linux/io_uring.h>
+#define STOPWATCH_HAVE_IO_URING 1
+#endif
+
+// A journal is a sequence of self-describing segments appended to one file.
+// Every segment starts with this header and is followed by payload_bytes of
+// records.
+constexpr std::uint32_t JOURNAL_MAGIC = 0x4a50414c; // "LAPJ"
+constexpr std::uint16_t JOURNAL_VERSION = 1;
+constexpr std::uint16_t JOURNAL_ENCODING_RAW = 0;
+constexpr std::uint16_t JOURNAL_ENCODING_GORILLA = 1;
+// Raw SampledJournalRecords. Records are not consecutive laps, so first_lap is
+// the lap number of the first one and every record carries its own split.
+constexpr std::uint16_t JOURNAL_ENCODING_SAMPLED = 2;
+// One JournalClockMap. Holds no laps; count is 1 and first_lap is the next
+// lap's number.
+constexpr std::uint16_t JOURNAL_ENCODING_CLOCK_MAP = 3;
+
+struct JournalSegmentHeader {
+    std::uint32_t magic;
+    std::uint16_t version;
+    std::uint16_t encoding;
+    std::uint32_t count;
+    std::uint32_t payload_bytes;
+    std::uint64_t source;
+    std::uint64_t first_lap;
+};
+
+static_assert(sizeof(JournalSegmentHeader) == 32, "journal header layout is part of the file format");
+
+// A lap recorded by a sampling stopwatch (see LapSampler): its own duration,
+// since its neighbours in the journal are other samples, and the weight (the
+// sampling rate it was drawn at) that scales it back to an estimate for all
+// laps.
+struct SampledJournalRecord {
+    std::int64_t elapsed_ns;
+    std::int64_t split_ns;
+    std::uint64_t lap;
+    std::int32_t cpu;
+    std::uint32_t weight;
+};
+
+static_assert(sizeof(SampledJournalRecord) == 32, "journal record layout is part of the file format");
+
+// Places the laps that follow on a timeline shared with other journals. Until
+// the next map, a lap with elapsed time e was taken at
+//   reference_ns + (e - elapsed_ns) * (1 + skew)
+// on the reference clock, give or take uncertainty_ns; that holds because
+// the stopwatch runs without pause between them. Journals whose maps name
+// the same reference_id can be merged on that clock. reference_id 0 means
+// no clock sync: the reference is CLOCK_REALTIME through the stopwatch's
+// anchor, good only to NTP accuracy.
+struct JournalClockMap {
+    std::int64_t elapsed_ns;
+    // The stopwatch clock domain's own reading at elapsed_ns.
+    std::int64_t local_ns;
+    std::int64_t reference_ns;
+    std::int64_t realtime_ns;
+    std::int64_t uncertainty_ns;
+    double skew;
+    std::uint64_t reference_id;
+    // A ClockDomain.
+    std::uint32_t domain;
+    std::uint32_t reserved;
+
+    std::int64_t referenceNs(std::int64_t lap_elapsed_ns) const {
+        double since = static_cast<double>(lap_elapsed_ns - elapsed_ns);
+        return reference_ns + static_cast<std::int64_t>(since * (1.0 + skew));
+    }
+};
+
+static_assert(sizeof(JournalClockMap) == 64, "journal record layout is part of the file format");
+
+// Completion-based write interface. write() queues a segment, commit() makes
+// the queued writes visible to the kernel (optionally followed by a data
+// sync), and reap() hands back the buffers whose writes have finished.
+class JournalBackend {
+public:
+    virtual ~JournalBackend() = default;
+    virtual const char* name() const = 0;
+    virtual void write(unsigned buffer, const char* data, std::size_t length, std::uint64_t offset) = 0;
+    virtual void commit(bool sync) = 0;
+    virtual void reap(bool wait, std::vector<unsigned>& completed) = 0;
+    virtual unsigned inFlight() const = 0;
+};
+
+// Writes all of data, looping on short writes; 0 or the errno.
+inline int journal_pwrite_all(int fd, const char* data, std::size_t length, std::uint64_t offset) {
+    while (length > 0) {
+        ssize_t n = ::pwrite(fd, data, length, static_cast<off_t>(offset));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        data += n;
+        length -= static_cast<std::size_t>(n);
+        offset += static_cast<std::uint64_t>(n);
+    }
+    return 0;
+}
+
+class PwriteJournalBackend : public JournalBackend {
+private:
+    int fd;
+    std::vector<unsigned> done;
+
+public:
+    explicit PwriteJournalBackend(int file) : fd(file) {}
+
+    const char* name() const override { return "pwrite"; }
+
+    void write(unsigned buffer, const char* data, std::size_t length, std::uint64_t offset) override {
+        if (int err = journal_pwrite_all(fd, data, length, offset)) {
+            throw std::runtime_error(std::string("Journal write failed: ") + std::strerror(err));
+        }
+        done.push_back(buffer);
+    }
+
+    void commit(bool sync) override {
+        if (sync && ::fdatasync(fd) != 0) {
+            throw std::runtime_error(std::string("Journal sync failed: ") + std::strerror(errno));
+        }
+    }
+
+    void reap(bool, std::vector<unsigned>& completed) override {
+        completed.insert(completed.end(), done.begin(), done.end());
+        done.clear();
+    }
+
+    unsigned inFlight() const override { return 0; }
+};
+
+#ifdef STOPWATCH_HAVE_IO_URING
+// io_uring through the raw syscalls, so no liburing dependency. Segment
+// buffers are registered once and written with WRITE_FIXED; a commit chains
+// all queued writes with IOSQE_IO_LINK and, when asked, ends the chain with a
+// datasync, so one io_uring_enter() covers a whole batch plus its fsync.
+//
+// A short write breaks the chain: the kernel cancels the rest of it. The
+// remainder and the cancelled writes and datasync are then finished
+// synchronously in reap(), in chain order, the way the pwrite backend would.
+class IoUringJournalBackend : public JournalBackend {
+private:
+    static constexpr std::uint64_t SYNC_TAG = ~std::uint64_t(0);
+
+    struct Request {
+        const char* data = nullptr;
+        std::size_t length = 0;
+        std::uint64_t offset = 0;
+    };
+
+    int fd;
+    int ring_fd = -1;
+    void* sq_ptr = MAP_FAILED;
+    std::size_t sq_len = 0;
+    void* cq_ptr = MAP_FAILED;
+    std::size_t cq_len = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    std::size_t sqes_len = 0;
+    unsigned* sq_head = nullptr;
+    unsigned* sq_tail = nullptr;
+    unsigned* sq_mask = nullptr;
+    unsigned* sq_array = nullptr;
+    unsigned sq_entries = 0;
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    unsigned* cq_mask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+    bool fixed_buffers = false;
+    unsigned queued = 0;
+    unsigned in_flight = 0;
+    io_uring_sqe* last_queued = nullptr;
+    // The write in flight for each buffer, by user_data.
+    std::vector<Request> requests;
+
+    static std::string errorText(const char* what, int err) {
+        return std::string(what) + ": " + std::strerror(err);
+    }
+
+    io_uring_sqe* nextSqe() {
+        unsigned head = std::atomic_ref<unsigned>(*sq_head).load(std::memory_order_acquire);
+        unsigned tail = *sq_tail;
+        if (tail - head >= sq_entries) {
+            enter(queued, 0, 0);
+            queued = 0;
+            head = std::atomic_ref<unsigned>(*sq_head).load(std::memory_order_acquire);
+            if (tail - head >= sq_entries) {
+                throw std::runtime_error("Journal submission queue is full");
+            }
+        }
+        unsigned index = tail & *sq_mask;
+        io_uring_sqe* sqe = &sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sq_array[index] = index;
+        return sqe;
+    }
+
+    void publishSqe() {
+        std::atomic_ref<unsigned>(*sq_tail).store(*sq_tail + 1, std::memory_order_release);
+        ++queued;
+        ++in_flight;
+    }
+
+    void enter(unsigned to_submit, unsigned min_complete, unsigned flags) {
+        while (true) {
+            long ret = ::syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0);
+            if (ret >= 0) {
+                return;
+            }
+            if (errno != EINTR) {
+                throw std::runtime_error(errorText("io_uring_enter failed", errno));
+            }
+        }
+    }
+
+    void release() {
+        if (sqes != MAP_FAILED) ::munmap(sqes, sqes_len);
+        if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr) ::munmap(cq_ptr, cq_len);
+        if (sq_ptr != MAP_FAILED) ::munmap(sq_ptr, sq_len);
+        if (ring_fd >= 0) ::close(ring_fd);
+    }
+
+public:
+    IoUringJournalBackend(int file, const std::vector<iovec>& buffers, unsigned depth) : fd(file), requests(buffers.size()) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        ring_fd = static_cast<int>(::syscall(__NR_io_uring_setup, depth, &params));
+        if (ring_fd < 0) {
+            throw std::runtime_error(errorText("io_uring_setup failed", errno));
+        }
+
+        sq_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_len = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mmap) {
+            sq_len = cq_len = std::max(sq_len, cq_len);
+        }
+        sq_ptr = ::mmap(nullptr, sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+        if (sq_ptr == MAP_FAILED) {
+            int err = errno;
+            release();
+            throw std::runtime_error(errorText("io_uring mmap failed", err));
+        }
+        cq_ptr = single_mmap ? sq_ptr
+                             : ::mmap(nullptr, cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        sqes_len = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe*>(::mmap(nullptr, sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES));
+        if (cq_ptr == MAP_FAILED || sqes == MAP_FAILED) {
+            int err = errno;
+            release();
+            throw std::runtime_error(errorText("io_uring mmap failed", err));
+        }
+
+        char* sq = static_cast<char*>(sq_ptr);
+        sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        sq_entries = params.sq_entries;
+        char* cq = static_cast<char*>(cq_ptr);
+        cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+        // Registration can fail under a low RLIMIT_MEMLOCK; plain WRITE still works.
+        fixed_buffers = ::syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_BUFFERS, buffers.data(), buffers.size()) == 0;
+    }
+
+    ~IoUringJournalBackend() override {
+        release();
+    }
+
+    IoUringJournalBackend(const IoUringJournalBackend&) = delete;
+    IoUringJournalBackend& operator=(const IoUringJournalBackend&) = delete;
+
+    const char* name() const override { return fixed_buffers ? "io_uring (registered buffers)" : "io_uring"; }
+
+    void write(unsigned buffer, const char* data, std::size_t length, std::uint64_t offset) override {
+        io_uring_sqe* sqe = nextSqe();
+        sqe->opcode = fixed_buffers ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<std::uint64_t>(data);
+        sqe->len = static_cast<std::uint32_t>(length);
+        sqe->off = offset;
+        sqe->buf_index = static_cast<std::uint16_t>(buffer);
+        sqe->user_data = buffer;
+        requests.at(buffer) = {data, length, offset};
+        if (last_queued) {
+            last_queued->flags |= IOSQE_IO_LINK;
+        }
+        last_queued = sqe;
+        publishSqe();
+    }
+
+    void commit(bool sync) override {
+        if (sync) {
+            io_uring_sqe* sqe = nextSqe();
+            sqe->opcode = IORING_OP_FSYNC;
+            sqe->fd = fd;
+            sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+            sqe->user_data = SYNC_TAG;
+            if (last_queued) {
+                last_queued->flags |= IOSQE_IO_LINK;
+            }
+            publishSqe();
+        }
+        last_queued = nullptr;
+        if (queued > 0) {
+            enter(queued, 0, 0);
+            queued = 0;
+        }
+    }
+
+    void reap(bool wait, std::vector<unsigned>& completed) override {
+        if (wait && in_flight > 0) {
+            if (*cq_head == std::atomic_ref<unsigned>(*cq_tail).load(std::memory_order_acquire)) {
+                enter(0, 1, IORING_ENTER_GETEVENTS);
+            }
+        }
+        unsigned head = *cq_head;
+        unsigned tail = std::atomic_ref<unsigned>(*cq_tail).load(std::memory_order_acquire);
+        int error = 0;
+        for (; head != tail; ++head) {
+            const io_uring_cqe& cqe = cqes[head & *cq_mask];
+            --in_flight;
+            bool sync = cqe.user_data == SYNC_TAG;
+            if (error != 0) {
+                // The batch has failed; only the buffers are handed back.
+            } else if (cqe.res == -ECANCELED) {
+                // Only a short write earlier in the chain cancels; an error
+                // there would already have been reported.
+                if (sync) {
+                    error = ::fdatasync(fd) != 0 ? errno : 0;
+                } else {
+                    const Request& r = requests[cqe.user_data];
+                    error = journal_pwrite_all(fd, r.data, r.length, r.offset);
+                }
+            } else if (cqe.res < 0) {
+                error = -cqe.res;
+            } else if (!sync && static_cast<std::size_t>(cqe.res) < requests[cqe.user_data].length) {
+                const Request& r = requests[cqe.user_data];
+                auto done = static_cast<std::size_t>(cqe.res);
+                error = journal_pwrite_all(fd, r.data + done, r.length - done, r.offset + done);
+            }
+            if (!sync) {
+                completed.push_back(static_cast<unsigned>(cqe.user_data));
+            }
+        }
+        std::atomic_ref<unsigned>(*cq_head).store(head, std::memory_order_release);
+        if (error != 0) {
+            throw std::runtime_error(errorText("Journal write failed", error));
+        }
+    }
+
+    unsigned inFlight() const override { return in_flight; }
+};
+#endif
+
+enum class JournalBackendKind {
+    Auto,
+    IoUring,
+    Pwrite
+};
+
+// Stages lap records and encodes them into fixed-size segment buffers, raw or
+// with the lap codec; a segment holds as many records as fit in the worst
+// case for its encoding. Full segments are only
+// queued; the queue is handed to the kernel when the writer runs out of free
+// buffers or on flush(), so a burst of segments costs one submission.
+class LapJournal {
+private:
+    struct FreeDeleter {
+        void operator()(char* p) const { std::free(p); }
+    };
+
+    int fd = -1;
+    std::size_t segment_bytes;
+    std::uint16_t encoding;
+    std::size_t segment_records;
+    std::uint64_t source;
+    std::uint64_t offset = 0;
+    std::vector<std::unique_ptr<char, FreeDeleter>> buffers;
+    std::vector<unsigned> free_buffers;
+    std::unique_ptr<JournalBackend> backend;
+    std::vector<unsigned> completed;
+
+    std::vector<JournalRecord> staged;
+    std::vector<SampledJournalRecord> staged_sampled;
+    std::size_t sampled_segment_records;
+    std::uint64_t next_lap = 1;
+
+    void recycle(bool wait) {
+        completed.clear();
+        backend->reap(wait, completed);
+        free_buffers.insert(free_buffers.end(), completed.begin(), completed.end());
+    }
+
+    unsigned acquire() {
+        if (free_buffers.empty()) {
+            backend->commit(false);
+            recycle(false);
+        }
+        while (free_buffers.empty()) {
+            recycle(true);
+        }
+        unsigned buffer = free_buffers.back();
+        free_buffers.pop_back();
+        return buffer;
+    }
+
+    void seal() {
+        if (!staged_sampled.empty()) {
+            sealSampled();
+        }
+        if (staged.empty()) {
+            return;
+        }
+        unsigned buffer = acquire();
+        char* base = buffers[buffer].get();
+        std::uint8_t* payload = reinterpret_cast<std::uint8_t*>(base + sizeof(JournalSegmentHeader));
+        std::size_t payload_bytes;
+        if (encoding == JOURNAL_ENCODING_GORILLA) {
+            payload_bytes = encode_laps(staged.data(), staged.size(), payload);
+        } else {
+            payload_bytes = staged.size() * sizeof(JournalRecord);
+            std::memcpy(payload, staged.data(), payload_bytes);
+        }
+        JournalSegmentHeader header{JOURNAL_MAGIC, JOURNAL_VERSION, encoding, static_cast<std::uint32_t>(staged.size()),
+                                    static_cast<std::uint32_t>(payload_bytes), source, next_lap - staged.size()};
+        std::memcpy(base, &header, sizeof(header));
+        std::size_t length = sizeof(header) + payload_bytes;
+        backend->write(buffer, base, length, offset);
+        offset += length;
+        staged.clear();
+    }
+
+    void sealSampled() {
+        unsigned buffer = acquire();
+        char* base = buffers[buffer].get();
+        std::size_t payload_bytes = staged_sampled.size() * sizeof(SampledJournalRecord);
+        std::memcpy(base + sizeof(JournalSegmentHeader), staged_sampled.data(), payload_bytes);
+        JournalSegmentHeader header{JOURNAL_MAGIC, JOURNAL_VERSION, JOURNAL_ENCODING_SAMPLED,
+                                    static_cast<std::uint32_t>(staged_sampled.size()),
+                                    static_cast<std::uint32_t>(payload_bytes), source, staged_sampled.front().lap};
+        std::memcpy(base, &header, sizeof(header));
+        std::size_t length = sizeof(header) + payload_bytes;
+        backend->write(buffer, base, length, offset);
+        offset += length;
+        staged_sampled.clear();
+    }
+
+public:
+    LapJournal(const std::string& path, std::uint64_t source_id = 0, JournalBackendKind kind = JournalBackendKind::Auto,
+               std::uint16_t record_encoding = JOURNAL_ENCODING_GORILLA, std::size_t segment_size = 64 * 1024,
+               unsigned buffer_count = 8)
+        : segment_bytes(segment_size), encoding(record_encoding), source(source_id) {
+        std::size_t space = segment_bytes > sizeof(JournalSegmentHeader) ? segment_bytes - sizeof(JournalSegmentHeader) : 0;
+        if (encoding == JOURNAL_ENCODING_GORILLA) {
+            segment_records = space > lap_codec_max_encoded_size(0) ? (space - lap_codec_max_encoded_size(0)) / LAP_CODEC_MAX_RECORD_BYTES : 0;
+        } else if (encoding == JOURNAL_ENCODING_RAW) {
+            segment_records = space / sizeof(JournalRecord);
+        } else {
+            throw std::runtime_error("Unknown journal encoding");
+        }
+        sampled_segment_records = space / sizeof(SampledJournalRecord);
+        if (segment_records == 0 || sampled_segment_records == 0 || space < sizeof(JournalClockMap)) {
+            throw std::runtime_error("Journal segment size is too small");
+        }
+        staged.reserve(segment_records);
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Unable to open journal " + path + ": " + std::strerror(errno));
+        }
+        off_t end = ::lseek(fd, 0, SEEK_END);
+        offset = end > 0 ? static_cast<std::uint64_t>(end) : 0;
+
+        std::vector<iovec> regions;
+        for (unsigned i = 0; i < buffer_count; ++i) {
+            char* p = static_cast<char*>(std::aligned_alloc(4096, (segment_bytes + 4095) / 4096 * 4096));
+            if (!p) {
+                ::close(fd);
+                throw std::bad_alloc();
+            }
+            buffers.emplace_back(p);
+            free_buffers.push_back(i);
+            regions.push_back({p, segment_bytes});
+        }
+
+#ifdef STOPWATCH_HAVE_IO_URING
+        if (kind != JournalBackendKind::Pwrite) {
+            try {
+                backend = std::make_unique<IoUringJournalBackend>(fd, regions, buffer_count * 2 + 2);
+            } catch (const std::exception&) {
+                if (kind == JournalBackendKind::IoUring) {
+                    ::close(fd);
+                    throw;
+                }
+            }
+        }
+#else
+        if (kind == JournalBackendKind::IoUring) {
+            ::close(fd);
+            throw std::runtime_error("io_uring is not available on this platform");
+        }
+#endif
+        if (!backend) {
+            backend = std::make_unique<PwriteJournalBackend>(fd);
+        }
+    }
+
+    ~LapJournal() {
+        try {
+            flush();
+        } catch (const std::exception&) {
+        }
+        backend.reset();
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+    LapJournal(const LapJournal&) = delete;
+    LapJournal& operator=(const LapJournal&) = delete;
+
+    const char* backendName() const { return backend->name(); }
+
+    // Laps are numbered consecutively from 1 unless told otherwise, e.g. when
+    // journaling starts part-way through a run or after sampled laps.
+    void setNextLap(std::uint64_t lap) {
+        if (lap != next_lap) {
+            seal();
+            next_lap = lap;
+        }
+    }
+
+    void append(const JournalRecord& record) {
+        if (!staged_sampled.empty()) {
+            sealSampled();
+        }
+        staged.push_back(record);
+        ++next_lap;
+        if (staged.size() == segment_records) {
+            seal();
+        }
+    }
+
+    void appendSampled(const SampledJournalRecord& record) {
+        if (!staged.empty()) {
+            seal();
+        }
+        staged_sampled.push_back(record);
+        next_lap = record.lap + 1;
+        if (staged_sampled.size() == sampled_segment_records) {
+            sealSampled();
+        }
+    }
+
+    // Ends the current segment and writes the map in one of its own, so it
+    // lands between the laps before and after it.
+    void appendClockMap(const JournalClockMap& map) {
+        seal();
+        unsigned buffer = acquire();
+        char* base = buffers[buffer].get();
+        std::memcpy(base + sizeof(JournalSegmentHeader), &map, sizeof(map));
+        JournalSegmentHeader header{JOURNAL_MAGIC, JOURNAL_VERSION, JOURNAL_ENCODING_CLOCK_MAP, 1,
+                                    static_cast<std::uint32_t>(sizeof(map)), source, next_lap};
+        std::memcpy(base, &header, sizeof(header));
+        std::size_t length = sizeof(header) + sizeof(map);
+        backend->write(buffer, base, length, offset);
+        offset += length;
+    }
+
+    // Writes out the partial segment and waits until everything queued so far
+    // is durable.
+    void flush() {
+        seal();
+        backend->commit(true);
+        while (backend->inFlight() > 0) {
+            recycle(true);
+        }
+        recycle(false);
+    }
+};
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+// Picks which laps to record when recording every one costs too much. Each
+// lap is taken independently with probability 1/N, so sampled laps carry a
+// weight of N and weighted statistics stay unbiased (see LapStats). Rather
+// than a random draw per lap, the gap to the next sample is drawn from the
+// matching geometric distribution whenever a sample is taken; the per-lap
+// cost is one decrement and a predictable branch. Independent draws, unlike a
+// fixed 1-in-N countdown, cannot alias with periodic work.
+//
+// Not thread-safe: give each recording thread its own sampler (a member of an
+// object the thread owns, or thread_local).
+//
+// With a budget, N adapts: every WINDOW_NS (10 ms) the time spent recording
+// samples is compared with the time that passed. Above the budget N grows by
+// the power of two that brings it back under in one step; below a quarter of
+// the budget N halves, so a step down cannot overshoot. A new N applies from
+// the next gap drawn, which keeps every weight equal to the rate its sample
+// was actually drawn at.
+class LapSampler {
+public:
+    static constexpr std::uint32_t MAX_RATE = 1u << 20;
+    static constexpr std::int64_t WINDOW_NS = 10000000;
+
+private:
+    std::uint64_t rng;
+    std::uint32_t current = 1;
+    std::uint32_t last_weight = 1;
+    std::uint64_t countdown = 1;
+    // 1 / ln(1 - 1/N), for turning a uniform draw into a geometric gap.
+    double gap_scale = 0.0;
+    double budget = 0.0;
+    std::int64_t window_start_ns = -1;
+    std::int64_t window_cost_ns = 0;
+
+    // splitmix64: a handful of arithmetic ops, passes BigCrush.
+    std::uint64_t next() {
+        std::uint64_t z = (rng += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    std::uint64_t draw() {
+        if (current <= 1) {
+            return 1;
+        }
+        // Uniform in (0, 1]: the top 53 bits, offset by one so log() is finite.
+        double u = static_cast<double>((next() >> 11) + 1) * 0x1.0p-53;
+        return 1 + static_cast<std::uint64_t>(std::log(u) * gap_scale);
+    }
+
+    void apply(std::uint32_t rate) {
+        current = std::clamp<std::uint32_t>(rate, 1, MAX_RATE);
+        gap_scale = current > 1 ? 1.0 / std::log1p(-1.0 / static_cast<double>(current)) : 0.0;
+        countdown = draw();
+    }
+
+public:
+    explicit LapSampler(std::uint32_t rate = 1, std::uint64_t seed = 0) {
+        if (seed == 0) {
+            seed = static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()) ^
+                   std::hash<std::thread::id>{}(std::this_thread::get_id());
+        }
+        rng = seed;
+        apply(rate);
+    }
+
+    // 1 records every lap.
+    void setRate(std::uint32_t rate) { apply(rate); }
+    std::uint32_t rate() const { return current; }
+
+    // Largest fraction of elapsed time to spend recording samples; 0 keeps N
+    // fixed.
+    void setBudget(double fraction) {
+        budget = std::max(0.0, fraction);
+        window_start_ns = -1;
+        window_cost_ns = 0;
+    }
+    double overheadBudget() const { return budget; }
+
+    bool active() const { return current > 1 || budget > 0.0; }
+
+    // Called once per lap; true if this one is to be recorded.
+    bool sample() {
+        if (--countdown > 0) {
+            return false;
+        }
+        last_weight = current;
+        countdown = draw();
+        return true;
+    }
+
+    // Weight for the lap sample() last returned true for.
+    std::uint32_t weight() const { return last_weight; }
+
+    // Reports what recording a sample cost, with the time it finished. Call
+    // between a true sample() and the next sample() so a changed N applies
+    // to the next gap only.
+    void recorded(std::int64_t cost_ns, std::int64_t now_ns) {
+        if (budget <= 0.0) {
+            return;
+        }
+        if (window_start_ns < 0) {
+            window_start_ns = now_ns - cost_ns;
+        }
+        window_cost_ns += cost_ns;
+        std::int64_t span = now_ns - window_start_ns;
+        if (span < WINDOW_NS) {
+            return;
+        }
+        double overhead = static_cast<double>(window_cost_ns) / static_cast<double>(span);
+        if (overhead > budget && current < MAX_RATE) {
+            double factor = std::min(std::ceil(overhead / budget), static_cast<double>(MAX_RATE));
+            // In 64 bits: the product can pass 2^32 before the clamp.
+            std::uint64_t rate = std::uint64_t{current} * std::bit_ceil(static_cast<std::uint32_t>(factor));
+            apply(static_cast<std::uint32_t>(std::min<std::uint64_t>(rate, MAX_RATE)));
+        } else if (overhead * 4.0 < budget && current > 1) {
+            apply(current / 2);
+        }
+        window_start_ns = now_ns;
+        window_cost_ns = 0;
+    }
+};
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+// Running statistics over nanosecond durations. Mergeable, so each worker
+// can keep its own and combine at the end.
+//
+// A sampled lap is recorded with the inverse of its sampling probability as
+// its weight, so count and sum are unbiased estimates of the full population
+// (Horvitz-Thompson) and mean and stddev are their ratio estimates. min and
+// max are those of the laps actually seen.
+struct LapStats {
+    std::uint64_t count = 0;
+    // Laps actually recorded; equal to count unless some were sampled.
+    std::uint64_t samples = 0;
+    double sum = 0.0;
+    double sum_sq = 0.0;
+    std::int64_t min = std::numeric_limits<std::int64_t>::max();
+    std::int64_t max = std::numeric_limits<std::int64_t>::min();
+
+    void record(std::int64_t ns, std::uint64_t weight = 1) {
+        count += weight;
+        ++samples;
+        double v = static_cast<double>(ns);
+        double w = static_cast<double>(weight);
+        sum += v * w;
+        sum_sq += v * v * w;
+        min = std::min(min, ns);
+        max = std::max(max, ns);
+    }
+
+    void merge(const LapStats& other) {
+        count += other.count;
+        samples += other.samples;
+        sum += other.sum;
+        sum_sq += other.sum_sq;
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+    }
+
+    double mean() const { return count ? sum / static_cast<double>(count) : 0.0; }
+
+    double stddev() const {
+        if (count < 2) {
+            return 0.0;
+        }
+        double m = mean();
+        double variance = sum_sq / static_cast<double>(count) - m * m;
+        return variance > 0.0 ? std::sqrt(variance) : 0.0;
+    }
+};
+
+// Log-linear histogram: values below 64 ns are exact, above that every power
+// of two is split into 32 sub-buckets, so any recorded value is reported
+// within about 3% of its true value.
+class LapHistogram {
+public:
+    static constexpr unsigned SUB_BITS = 5;
+    static constexpr unsigned SUB_BUCKETS = 1u << SUB_BITS;
+    static constexpr unsigned BUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS;
+
+private:
+    std::array<std::uint64_t, BUCKETS> counts{};
+    std::uint64_t total = 0;
+
+public:
+    static unsigned bucketFor(std::uint64_t value) {
+        if (value < 2 * SUB_BUCKETS) {
+            return static_cast<unsigned>(value);
+        }
+        unsigned exponent = 63 - static_cast<unsigned>(std::countl_zero(value));
+        unsigned shift = exponent - SUB_BITS;
+        return (shift + 1) * SUB_BUCKETS + static_cast<unsigned>(value >> shift) - SUB_BUCKETS;
+    }
+
+    static std::uint64_t bucketLowerBound(unsigned bucket) {
+        if (bucket < 2 * SUB_BUCKETS) {
+            return bucket;
+        }
+        unsigned shift = bucket / SUB_BUCKETS - 1;
+        return static_cast<std::uint64_t>(bucket % SUB_BUCKETS + SUB_BUCKETS) << shift;
+    }
+
+    static std::uint64_t bucketUpperBound(unsigned bucket) {
+        if (bucket < 2 * SUB_BUCKETS) {
+            return bucket;
+        }
+        unsigned shift = bucket / SUB_BUCKETS - 1;
+        return bucketLowerBound(bucket) + ((std::uint64_t(1) << shift) - 1);
+    }
+
+    void record(std::int64_t ns, std::uint64_t weight = 1) {
+        counts[bucketFor(ns > 0 ? static_cast<std::uint64_t>(ns) : 0)] += weight;
+        total += weight;
+    }
+
+    // For counts that were bucketed elsewhere, e.g. a delta from another
+    // process.
+    void addToBucket(unsigned bucket, std::uint64_t weight) {
+        counts[bucket] += weight;
+        total += weight;
+    }
+
+    void merge(const LapHistogram& other) {
+        for (unsigned i = 0; i < BUCKETS; ++i) {
+            counts[i] += other.counts[i];
+        }
+        total += other.total;
+    }
+
+    std::uint64_t count() const { return total; }
+    std::uint64_t bucketCount(unsigned bucket) const { return counts[bucket]; }
+
+    // Midpoint of the bucket holding the q-quantile (0 <= q <= 1).
+    std::uint64_t percentile(double q) const {
+        if (total == 0) {
+            return 0;
+        }
+        auto rank = static_cast<std::uint64_t>(std::ceil(q * static_cast<double>(total)));
+        rank = std::clamp<std::uint64_t>(rank, 1, total);
+        std::uint64_t seen = 0;
+        for (unsigned i = 0; i < BUCKETS; ++i) {
+            seen += counts[i];
+            if (seen >= rank) {
+                return bucketLowerBound(i) + (bucketUpperBound(i) - bucketLowerBound(i)) / 2;
+            }
+        }
+        return bucketUpperBound(BUCKETS - 1);
+    }
+};
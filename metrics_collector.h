@@ -0,0 +1,165 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "lap_stats.h"
+#include "metrics_wire.h"
+#include "time_format.h"
+
+// Aggregates the Delta and Names datagrams of any number of reporters into
+// one set of per-timer totals. Timers with the same name in different
+// processes share a key and so are merged. Single-threaded: the daemon
+// ingests and reports from one loop.
+class MetricsCollector {
+public:
+    struct Timer {
+        std::string name;
+        LapStats stats;
+        LapHistogram histogram;
+    };
+
+    struct Counters {
+        std::uint64_t datagrams = 0;
+        std::uint64_t bytes = 0;
+        std::uint64_t deltas = 0;
+        std::uint64_t malformed = 0;
+        // Datagrams missing from reporters' sequences.
+        std::uint64_t lost = 0;
+    };
+
+private:
+    std::unordered_map<std::uint64_t, Timer> timers;
+    std::unordered_map<std::uint32_t, std::uint32_t> next_sequence;
+    Counters totals;
+    TimerDelta scratch;
+
+    void track(const MetricsHeader& header) {
+        auto [it, first] = next_sequence.try_emplace(header.pid, header.sequence);
+        // A lower number means the pid now belongs to a new reporter.
+        if (!first && header.sequence > it->second) {
+            totals.lost += header.sequence - it->second;
+        }
+        it->second = header.sequence + 1;
+    }
+
+    static std::string label(std::uint64_t key, const Timer& timer) {
+        if (!timer.name.empty()) {
+            return timer.name;
+        }
+        char buf[20] = {'#'};
+        return std::string(buf, std::to_chars(buf + 1, buf + sizeof(buf), key, 16).ptr);
+    }
+
+    // Pads to a column width counted in characters, not bytes (µs).
+    static void pad(std::string& out, std::size_t from, std::size_t width, bool left) {
+        std::size_t chars = 0;
+        for (std::size_t i = from; i < out.size(); ++i) {
+            chars += (static_cast<unsigned char>(out[i]) & 0xc0) != 0x80;
+        }
+        if (chars < width) {
+            out.insert(left ? out.size() : from, width - chars, ' ');
+        }
+    }
+
+public:
+    // Takes a Delta or Names datagram; false if it is malformed or of
+    // another type. A malformed Delta may have been partly applied.
+    bool ingest(const void* data, std::size_t size) {
+        const auto* p = static_cast<const std::uint8_t*>(data);
+        const std::uint8_t* end = p + size;
+        MetricsHeader header;
+        if (!read_metrics_header(p, end, header) ||
+            (header.type != MetricsMessage::Delta && header.type != MetricsMessage::Names)) {
+            ++totals.malformed;
+            return false;
+        }
+        ++totals.datagrams;
+        totals.bytes += size;
+        track(header);
+        bool ok = true;
+        if (header.type == MetricsMessage::Names) {
+            std::uint64_t key;
+            std::string name;
+            while (p < end && (ok = decode_timer_name(p, end, key, name))) {
+                timers[key].name = name;
+            }
+        } else {
+            while (p < end && (ok = decode_timer_delta(p, end, scratch))) {
+                Timer& timer = timers[scratch.key];
+                timer.stats.merge(scratch.stats);
+                for (const auto& [bucket, count] : scratch.buckets) {
+                    timer.histogram.addToBucket(bucket, count);
+                }
+                ++totals.deltas;
+            }
+        }
+        if (!ok) {
+            ++totals.malformed;
+        }
+        return ok;
+    }
+
+    // One row per timer whose name starts with prefix, sorted by name:
+    // count, mean, percentiles and max. Percentiles are bucket midpoints
+    // (within about 3%) clamped to the observed range; counts are estimates
+    // where reporters sampled.
+    void report(std::string& out, std::string_view prefix = {}) const {
+        std::vector<std::pair<std::string, const Timer*>> rows;
+        for (const auto& [key, timer] : timers) {
+            if (timer.stats.count == 0 || (!prefix.empty() && timer.name.compare(0, prefix.size(), prefix) != 0)) {
+                continue;
+            }
+            rows.emplace_back(label(key, timer), &timer);
+        }
+        std::sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+        std::size_t name_width = 5;
+        for (const auto& row : rows) {
+            name_width = std::max(name_width, row.first.size());
+        }
+        constexpr std::size_t COLUMN = 13;
+        auto cell = [&out](std::string_view text, std::size_t width, bool left) {
+            std::size_t from = out.size();
+            out += text;
+            pad(out, from, width, left);
+        };
+        cell("timer", name_width, true);
+        for (const char* heading : {"count", "mean", "p50", "p90", "p99", "p99.9", "max"}) {
+            cell(heading, COLUMN, false);
+        }
+        out += '\n';
+        for (const auto& [name, timer] : rows) {
+            const LapStats& s = timer->stats;
+            cell(name, name_width, true);
+            char buf[24];
+            cell(std::string_view(buf, std::to_chars(buf, buf + sizeof(buf), s.count).ptr - buf), COLUMN, false);
+            auto duration = [&](std::int64_t ns) {
+                std::size_t from = out.size();
+                append_duration(out, ns, TimeFormat::Auto);
+                pad(out, from, COLUMN, false);
+            };
+            duration(static_cast<std::int64_t>(s.mean()));
+            for (double q : {0.50, 0.90, 0.99, 0.999}) {
+                auto v = static_cast<std::int64_t>(timer->histogram.percentile(q));
+                duration(std::clamp(v, s.min, s.max));
+            }
+            duration(s.max);
+            out += '\n';
+        }
+    }
+
+    const Timer* find(std::string_view name) const {
+        auto it = timers.find(metrics_key(name));
+        return it != timers.end() ? &it->second : nullptr;
+    }
+
+    std::size_t timerCount() const { return timers.size(); }
+    std::size_t reporterCount() const { return next_sequence.size(); }
+    const Counters& counters() const { return totals; }
+};
@@ -0,0 +1,303 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "lap_stats.h"
+#include "metrics_wire.h"
+
+// Sends this process's timer statistics to the stopwatch-collector daemon.
+// Timers are registered by name once; record() adds a duration to the
+// timer's delta, and a flusher thread sends every timer that changed once
+// per interval as Delta datagrams (see metrics_wire.h), then starts the
+// deltas over; the collector keeps the running totals. A datagram that can't
+// be sent (no collector listening, or one too far behind to take it within
+// the send timeout) has its deltas folded back in to go with the next
+// flush, so nothing is lost while a collector restarts or catches up.
+//
+// record() holds a mutex for an append to the timer's pending list, so it
+// suits laps and requests rather than tight loops; bucket counts are
+// combined when the list grows long and at each flush.
+class MetricsReporter {
+public:
+    static constexpr std::size_t MAX_NAME = 1024;
+    // Names are re-sent every this many flushes, for collectors that
+    // started after the timers were registered.
+    static constexpr unsigned NAMES_EVERY = 30;
+
+private:
+    struct Timer {
+        std::string name;
+        std::uint64_t key;
+        LapStats stats;
+        // Recorded since the last compaction: bucket << 32 | weight.
+        std::vector<std::uint64_t> pending;
+        // Compacted bucket counts, sorted by bucket.
+        std::vector<std::pair<std::uint32_t, std::uint64_t>> buckets;
+    };
+
+    static constexpr std::size_t COMPACT_AT = 4096;
+
+    int fd = -1;
+    sockaddr_un address{};
+    socklen_t address_length = 0;
+    std::uint32_t pid;
+    std::chrono::milliseconds flush_interval;
+
+    std::mutex mtx;
+    std::vector<Timer> timers;
+    std::unordered_map<std::string, std::size_t> by_name;
+    bool names_changed = false;
+
+    // Held through a flush so sends from the flusher and flush() don't
+    // interleave their sequence numbers.
+    std::mutex send_mtx;
+    std::uint32_t sequence = 0;
+    unsigned flushes = 0;
+    std::atomic<std::uint64_t> sent{0};
+    std::atomic<std::uint64_t> failed{0};
+
+    std::mutex wake_mtx;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::thread flusher;
+
+    using Buckets = std::vector<std::pair<std::uint32_t, std::uint64_t>>;
+
+    // Adds sorted bucket counts into sorted bucket counts.
+    static void mergeBuckets(Buckets& into, const Buckets& more) {
+        Buckets merged;
+        merged.reserve(into.size() + more.size());
+        auto a = into.begin();
+        auto b = more.begin();
+        while (a != into.end() || b != more.end()) {
+            if (b == more.end() || (a != into.end() && a->first < b->first)) {
+                merged.push_back(*a++);
+            } else if (a == into.end() || b->first < a->first) {
+                merged.push_back(*b++);
+            } else {
+                merged.emplace_back(a->first, a->second + b->second);
+                ++a;
+                ++b;
+            }
+        }
+        into.swap(merged);
+    }
+
+    static void compact(Timer& timer) {
+        if (timer.pending.empty()) {
+            return;
+        }
+        std::sort(timer.pending.begin(), timer.pending.end());
+        Buckets counted;
+        for (std::uint64_t entry : timer.pending) {
+            auto bucket = static_cast<std::uint32_t>(entry >> 32);
+            if (counted.empty() || counted.back().first != bucket) {
+                counted.emplace_back(bucket, 0);
+            }
+            counted.back().second += static_cast<std::uint32_t>(entry);
+        }
+        timer.pending.clear();
+        mergeBuckets(timer.buckets, counted);
+    }
+
+    // Sequence numbers only advance on success, so the collector's gap
+    // count is datagrams lost after sending.
+    bool send(std::string& datagram) {
+        std::memcpy(datagram.data() + offsetof(MetricsHeader, sequence), &sequence, sizeof(sequence));
+        ssize_t n = ::sendto(fd, datagram.data(), datagram.size(), MSG_NOSIGNAL,
+                             reinterpret_cast<const sockaddr*>(&address), address_length);
+        if (n != static_cast<ssize_t>(datagram.size())) {
+            failed.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        ++sequence;
+        sent.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Packs entries into datagrams of at most METRICS_MAX_DATAGRAM bytes.
+    // unsent(first, last) is called for the entries of a datagram that
+    // could not be sent.
+    template <typename Encode, typename Unsent>
+    bool sendAll(MetricsMessage type, std::size_t count, Encode encode, Unsent unsent) {
+        std::string datagram, entry;
+        std::size_t first = 0;
+        bool all = true;
+        auto finish = [&](std::size_t last) {
+            if (!send(datagram)) {
+                unsent(first, last);
+                all = false;
+            }
+            datagram.clear();
+            first = last;
+        };
+        for (std::size_t i = 0; i < count; ++i) {
+            entry.clear();
+            encode(entry, i);
+            if (datagram.size() + entry.size() > METRICS_MAX_DATAGRAM) {
+                finish(i);
+            }
+            if (datagram.empty()) {
+                put_metrics_header(datagram, type, 0, pid, 0);
+            }
+            datagram += entry;
+        }
+        if (!datagram.empty()) {
+            finish(count);
+        }
+        return all;
+    }
+
+public:
+    explicit MetricsReporter(const std::string& socket_path = METRICS_DEFAULT_SOCKET,
+                             std::chrono::milliseconds interval = std::chrono::seconds(1))
+        : pid(static_cast<std::uint32_t>(::getpid())), flush_interval(interval) {
+        if (socket_path.size() >= sizeof(address.sun_path)) {
+            throw std::runtime_error("Collector socket path is too long");
+        }
+        fd = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            throw std::runtime_error(std::string("Unable to create metrics socket: ") + std::strerror(errno));
+        }
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+        address_length = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + socket_path.size() + 1);
+        // A collector that has fallen behind blocks sends for at most this
+        // long, so one stuck daemon can't stall the flusher indefinitely.
+        timeval timeout{0, 100000};
+        ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        flusher = std::thread([this]() {
+            std::unique_lock<std::mutex> lock(wake_mtx);
+            while (true) {
+                bool last = wake.wait_for(lock, flush_interval, [this]() { return stopping; });
+                lock.unlock();
+                flush();
+                if (last) {
+                    return;
+                }
+                lock.lock();
+            }
+        });
+    }
+
+    ~MetricsReporter() {
+        {
+            std::lock_guard<std::mutex> lock(wake_mtx);
+            stopping = true;
+        }
+        wake.notify_all();
+        flusher.join();
+        ::close(fd);
+    }
+
+    MetricsReporter(const MetricsReporter&) = delete;
+    MetricsReporter& operator=(const MetricsReporter&) = delete;
+
+    // Index of the timer with this name, registering it on first use.
+    std::size_t timer(std::string_view name) {
+        if (name.size() > MAX_NAME) {
+            throw std::length_error("Timer name is too long");
+        }
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = by_name.find(std::string(name));
+        if (it != by_name.end()) {
+            return it->second;
+        }
+        timers.push_back({std::string(name), metrics_key(name), {}, {}, {}});
+        by_name.emplace(std::string(name), timers.size() - 1);
+        names_changed = true;
+        return timers.size() - 1;
+    }
+
+    // weight as for LapStats::record(), at most 2^32 - 1.
+    void record(std::size_t index, std::int64_t ns, std::uint32_t weight = 1) {
+        std::uint64_t bucket = LapHistogram::bucketFor(ns > 0 ? static_cast<std::uint64_t>(ns) : 0);
+        std::lock_guard<std::mutex> lock(mtx);
+        Timer& t = timers.at(index);
+        t.stats.record(ns, weight);
+        t.pending.push_back(bucket << 32 | weight);
+        if (t.pending.size() >= COMPACT_AT) {
+            compact(t);
+        }
+    }
+
+    // Sends everything recorded since the previous flush; false if some of
+    // it has to wait for the next one. Called by the flusher thread every
+    // interval and on destruction; call it directly before exiting early.
+    bool flush() {
+        std::vector<TimerDelta> deltas;
+        std::vector<std::size_t> owners;
+        std::vector<std::pair<std::uint64_t, std::string>> names;
+        bool send_names;
+        std::lock_guard<std::mutex> sending(send_mtx);
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            send_names = names_changed || flushes % NAMES_EVERY == 0;
+            names_changed = false;
+            for (std::size_t i = 0; i < timers.size(); ++i) {
+                Timer& t = timers[i];
+                if (send_names) {
+                    names.emplace_back(t.key, t.name);
+                }
+                if (t.stats.samples == 0) {
+                    continue;
+                }
+                compact(t);
+                TimerDelta& d = deltas.emplace_back();
+                d.key = t.key;
+                d.stats = t.stats;
+                d.buckets.swap(t.buckets);
+                t.stats = LapStats();
+                owners.push_back(i);
+            }
+        }
+        ++flushes;
+        bool all = true;
+        if (send_names) {
+            all = sendAll(MetricsMessage::Names, names.size(),
+                          [&](std::string& out, std::size_t i) { encode_timer_name(out, names[i].first, names[i].second); },
+                          [&](std::size_t, std::size_t) {
+                              std::lock_guard<std::mutex> lock(mtx);
+                              names_changed = true;
+                          });
+        }
+        all &= sendAll(MetricsMessage::Delta, deltas.size(),
+                       [&](std::string& out, std::size_t i) { encode_timer_delta(out, deltas[i]); },
+                       [&](std::size_t first, std::size_t last) {
+                           std::lock_guard<std::mutex> lock(mtx);
+                           for (std::size_t i = first; i < last; ++i) {
+                               Timer& t = timers[owners[i]];
+                               t.stats.merge(deltas[i].stats);
+                               mergeBuckets(t.buckets, deltas[i].buckets);
+                           }
+                       });
+        return all;
+    }
+
+    std::size_t timerCount() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return timers.size();
+    }
+
+    std::uint64_t sentCount() const { return sent.load(std::memory_order_relaxed); }
+    // Datagrams that could not be sent and were retried with a later flush.
+    std::uint64_t failedCount() const { return failed.load(std::memory_order_relaxed); }
+};
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "lap_codec.h"
+#include "lap_stats.h"
+
+// Datagrams between MetricsReporter (one per worker process) and the
+// stopwatch-collector daemon over a Unix datagram socket. Both ends are on
+// one host, so integers that are not varints are in native byte order.
+// Every datagram starts with a MetricsHeader:
+//   Delta   per-timer changes since the reporter's previous flush.
+//   Names   key -> name for the timers a reporter knows; re-sent now and
+//           then so a restarted collector can label what it aggregates.
+//   Query   asks for a report; the body is an optional timer-name prefix.
+//   Report  text reply to a query, split over datagrams; all but the last
+//           carry METRICS_FLAG_MORE.
+//   SyncRequest, SyncReply
+//           clock synchronization pings answered with the collector's
+//           clock (see clock_sync.h).
+constexpr std::uint32_t METRICS_MAGIC = 0x44435753; // "SWCD"
+constexpr std::uint8_t METRICS_VERSION = 1;
+constexpr std::uint16_t METRICS_FLAG_MORE = 1;
+constexpr std::size_t METRICS_MAX_DATAGRAM = 32 * 1024;
+constexpr const char* METRICS_DEFAULT_SOCKET = "/tmp/stopwatch-collector.sock";
+
+enum class MetricsMessage : std::uint8_t {
+    Delta = 1,
+    Names = 2,
+    Query = 3,
+    Report = 4,
+    SyncRequest = 5,
+    SyncReply = 6
+};
+
+struct MetricsHeader {
+    std::uint32_t magic;
+    std::uint8_t version;
+    MetricsMessage type;
+    std::uint16_t flags;
+    std::uint32_t pid;
+    // Counts the datagrams a reporter has sent; a gap means some were lost.
+    std::uint32_t sequence;
+};
+
+static_assert(sizeof(MetricsHeader) == 16, "metrics header layout is part of the wire format");
+
+// Timers are identified by a 64-bit FNV-1a hash of their name, so processes
+// agree on keys without coordinating and deltas don't repeat the names.
+inline std::uint64_t metrics_key(std::string_view name) {
+    std::uint64_t hash = 0xcbf29ce484222325ull;
+    for (char c : name) {
+        hash = (hash ^ static_cast<std::uint8_t>(c)) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// One timer's changes since the previous flush. Buckets are LapHistogram
+// bucket indices in increasing order with their (weighted) counts.
+struct TimerDelta {
+    std::uint64_t key = 0;
+    LapStats stats;
+    std::vector<std::pair<std::uint32_t, std::uint64_t>> buckets;
+};
+
+namespace metrics_wire {
+
+inline void put_varint(std::string& out, std::uint64_t v) {
+    while (v >= 0x80) {
+        out += static_cast<char>(v | 0x80);
+        v >>= 7;
+    }
+    out += static_cast<char>(v);
+}
+
+inline bool get_varint(const std::uint8_t*& p, const std::uint8_t* end, std::uint64_t& v) {
+    v = 0;
+    for (unsigned shift = 0; shift < 64 && p < end; shift += 7) {
+        std::uint8_t byte = *p++;
+        v |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename T>
+inline void put_raw(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+inline bool get_raw(const std::uint8_t*& p, const std::uint8_t* end, T& value) {
+    if (static_cast<std::size_t>(end - p) < sizeof(value)) {
+        return false;
+    }
+    std::memcpy(&value, p, sizeof(value));
+    p += sizeof(value);
+    return true;
+}
+
+}
+
+inline void put_metrics_header(std::string& out, MetricsMessage type, std::uint16_t flags, std::uint32_t pid,
+                               std::uint32_t sequence) {
+    MetricsHeader header{METRICS_MAGIC, METRICS_VERSION, type, flags, pid, sequence};
+    metrics_wire::put_raw(out, header);
+}
+
+// Key, counts and extremes as varints, the two sums as doubles, then the
+// non-empty buckets as (gap from the previous index, count) varint pairs. A
+// timer with a few dozen distinct buckets takes around a hundred bytes.
+inline void encode_timer_delta(std::string& out, const TimerDelta& delta) {
+    using namespace metrics_wire;
+    put_raw(out, delta.key);
+    put_varint(out, delta.stats.count);
+    put_varint(out, delta.stats.samples);
+    put_varint(out, zigzag(delta.stats.min));
+    put_varint(out, zigzag(delta.stats.max));
+    put_raw(out, delta.stats.sum);
+    put_raw(out, delta.stats.sum_sq);
+    put_varint(out, delta.buckets.size());
+    std::uint32_t previous = 0;
+    for (const auto& [bucket, count] : delta.buckets) {
+        put_varint(out, bucket - previous);
+        put_varint(out, count);
+        previous = bucket;
+    }
+}
+
+inline bool decode_timer_delta(const std::uint8_t*& p, const std::uint8_t* end, TimerDelta& delta) {
+    using namespace metrics_wire;
+    std::uint64_t min, max, n;
+    if (!get_raw(p, end, delta.key) || !get_varint(p, end, delta.stats.count) ||
+        !get_varint(p, end, delta.stats.samples) || !get_varint(p, end, min) || !get_varint(p, end, max) ||
+        !get_raw(p, end, delta.stats.sum) || !get_raw(p, end, delta.stats.sum_sq) || !get_varint(p, end, n) ||
+        n > LapHistogram::BUCKETS) {
+        return false;
+    }
+    delta.stats.min = unzigzag(min);
+    delta.stats.max = unzigzag(max);
+    delta.buckets.clear();
+    std::uint64_t bucket = 0;
+    for (std::uint64_t i = 0; i < n; ++i) {
+        std::uint64_t gap, count;
+        if (!get_varint(p, end, gap) || !get_varint(p, end, count)) {
+            return false;
+        }
+        bucket += gap;
+        if (bucket >= LapHistogram::BUCKETS) {
+            return false;
+        }
+        delta.buckets.emplace_back(static_cast<std::uint32_t>(bucket), count);
+    }
+    return true;
+}
+
+// Names entries: the key, then the name's length and bytes.
+inline void encode_timer_name(std::string& out, std::uint64_t key, std::string_view name) {
+    metrics_wire::put_raw(out, key);
+    metrics_wire::put_varint(out, name.size());
+    out += name;
+}
+
+inline bool decode_timer_name(const std::uint8_t*& p, const std::uint8_t* end, std::uint64_t& key, std::string& name) {
+    std::uint64_t length;
+    if (!metrics_wire::get_raw(p, end, key) || !metrics_wire::get_varint(p, end, length) ||
+        length > static_cast<std::uint64_t>(end - p)) {
+        return false;
+    }
+    name.assign(reinterpret_cast<const char*>(p), length);
+    p += length;
+    return true;
+}
+
+// Reads and checks the header; false if the datagram isn't one of ours.
+inline bool read_metrics_header(const std::uint8_t*& p, const std::uint8_t* end, MetricsHeader& header) {
+    return metrics_wire::get_raw(p, end, header) && header.magic == METRICS_MAGIC && header.version == METRICS_VERSION;
+}
@@ -0,0 +1,240 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "time_format.h"
+
+enum class StatusState {
+    Running,
+    Paused,
+    Stopped
+};
+
+inline const char* to_string(StatusState state) {
+    switch (state) {
+        case StatusState::Running: return "Running";
+        case StatusState::Paused: return "Paused";
+        case StatusState::Stopped: return "Stopped";
+    }
+    return "Stopped";
+}
+
+// "Elapsed time: <duration>" without the trailing newline.
+inline void append_elapsed(std::string& out, std::int64_t ns, TimeFormat format) {
+    out += "Elapsed time: ";
+    append_duration(out, ns, format);
+}
+
+enum class ProgressStyle {
+    Ascii,
+    Blocks
+};
+
+inline const char* to_string(ProgressStyle style) {
+    switch (style) {
+        case ProgressStyle::Ascii: return "ascii";
+        case ProgressStyle::Blocks: return "blocks";
+    }
+    return "ascii";
+}
+
+inline bool parse_progress_style(std::string_view name, ProgressStyle& style) {
+    for (ProgressStyle s : {ProgressStyle::Ascii, ProgressStyle::Blocks}) {
+        if (name == to_string(s)) {
+            style = s;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Lap count and a moving average of recent lap intervals, for the progress
+// bar's rate and ETA. Kept apart from the bar so a stopwatch can update it
+// with its other per-lap state and leave the bar to the display thread.
+struct LapRate {
+    std::uint64_t laps = 0;
+    std::int64_t last_lap_ns = 0;
+    double interval_ns = 0.0;
+
+    // lap_number is the lap that just ended; laps skipped by sampling since
+    // the last call share the interval evenly.
+    void record(std::int64_t elapsed_ns, std::uint64_t lap_number) {
+        std::uint64_t ended = lap_number > laps ? lap_number - laps : 1;
+        double interval = static_cast<double>(elapsed_ns - last_lap_ns) / static_cast<double>(ended);
+        interval_ns = laps == 0 ? interval : interval_ns + (interval - interval_ns) / 4.0;
+        last_lap_ns = elapsed_ns;
+        laps += ended;
+    }
+
+    void reset() { *this = LapRate(); }
+
+    double lapsPerSecond() const { return interval_ns > 0.0 ? 1e9 / interval_ns : 0.0; }
+};
+
+// Progress toward a target duration or lap count, or a sweep that restarts
+// every minute when neither is set. The Blocks style draws the leading cell
+// with Unicode eighth blocks for sub-character resolution. The bar body is
+// cached between frames; since progress only moves at the fill edge, only the
+// cells from the old edge onward are rebuilt.
+class ProgressBar {
+public:
+    static constexpr int WIDTH = 50;
+
+private:
+    ProgressStyle style = ProgressStyle::Ascii;
+    std::int64_t target_ns = 0;
+    std::uint64_t target_laps = 0;
+    LapRate own_rate;
+    const LapRate* rate = &own_rate;
+    std::string cells;
+    int cached_units = -1;
+
+    int unitsPerCell() const { return style == ProgressStyle::Blocks ? 8 : 1; }
+
+    // Bytes taken by cells [0, cell) when the fill edge is at or past it:
+    // every filled cell is three bytes in UTF-8 for Blocks, one for Ascii.
+    std::size_t offsetOf(int cell) const {
+        return static_cast<std::size_t>(cell) * (style == ProgressStyle::Blocks ? 3 : 1);
+    }
+
+    void appendCell(int cell, int units) {
+        if (style == ProgressStyle::Ascii) {
+            // The edge cell is drawn as '>' unless the bar is full.
+            cells += cell < units ? '=' : cell == units ? '>' : ' ';
+            return;
+        }
+        int eighths = units - cell * 8;
+        if (eighths >= 8) {
+            cells += "\xE2\x96\x88";
+        } else if (eighths > 0) {
+            cells += "\xE2\x96";
+            cells += static_cast<char>(0x90 - eighths);
+        } else {
+            cells += ' ';
+        }
+    }
+
+    void update(int units) {
+        if (units == cached_units) {
+            return;
+        }
+        int first = 0;
+        if (cached_units >= 0) {
+            first = std::min(cached_units, units) / unitsPerCell();
+        }
+        cells.resize(offsetOf(first));
+        for (int cell = first; cell < WIDTH; ++cell) {
+            appendCell(cell, units);
+        }
+        cached_units = units;
+    }
+
+public:
+    void configure(ProgressStyle bar_style, std::int64_t duration_ns, std::uint64_t lap_goal) {
+        if (bar_style != style) {
+            cached_units = -1;
+        }
+        style = bar_style;
+        target_ns = duration_ns;
+        target_laps = lap_goal;
+    }
+
+    ProgressBar() = default;
+    ProgressBar(const ProgressBar&) = delete;
+    ProgressBar& operator=(const ProgressBar&) = delete;
+
+    // Reads laps from source, which must outlive the bar, instead of its
+    // own recordLap() calls.
+    void setLapRate(const LapRate* source) { rate = source ? source : &own_rate; }
+
+    // Feeds the bar's own rate estimate (see LapRate::record()).
+    void recordLap(std::int64_t elapsed_ns, std::uint64_t lap_number) { own_rate.record(elapsed_ns, lap_number); }
+
+    void reset() { own_rate.reset(); }
+
+    double fraction(std::int64_t elapsed_ns) const {
+        double f;
+        if (target_laps > 0) {
+            f = static_cast<double>(rate->laps) / static_cast<double>(target_laps);
+        } else if (target_ns > 0) {
+            f = static_cast<double>(elapsed_ns) / static_cast<double>(target_ns);
+        } else {
+            f = static_cast<double>(elapsed_ns % 60000000000ll) / 60e9;
+        }
+        return std::clamp(f, 0.0, 1.0);
+    }
+
+    double lapsPerSecond() const { return rate->lapsPerSecond(); }
+
+    // Time left until the target, or -1 when there is no target or no rate yet.
+    std::int64_t etaNs(std::int64_t elapsed_ns) const {
+        if (target_laps > 0) {
+            if (rate->laps >= target_laps) {
+                return 0;
+            }
+            if (rate->laps == 0) {
+                return -1;
+            }
+            double remaining = static_cast<double>(target_laps - rate->laps) * rate->interval_ns -
+                               static_cast<double>(elapsed_ns - rate->last_lap_ns);
+            return static_cast<std::int64_t>(std::max(remaining, 0.0));
+        }
+        if (target_ns > 0) {
+            return std::max<std::int64_t>(target_ns - elapsed_ns, 0);
+        }
+        return -1;
+    }
+
+    void render(std::string& out, std::int64_t elapsed_ns, TimeFormat format) {
+        int units = static_cast<int>(fraction(elapsed_ns) * WIDTH * unitsPerCell());
+        update(units);
+        out += '[';
+        out += cells;
+        out += "] ";
+        char buf[32];
+        if (target_laps == 0 && target_ns == 0) {
+            out.append(buf, std::to_chars(buf, buf + sizeof(buf), elapsed_ns / 1000000000 % 60).ptr);
+            out += 's';
+            return;
+        }
+        out.append(buf, std::to_chars(buf, buf + sizeof(buf), fraction(elapsed_ns) * 100.0, std::chars_format::fixed, 1).ptr);
+        out += '%';
+        if (target_laps > 0) {
+            out += "  ";
+            out.append(buf, std::to_chars(buf, buf + sizeof(buf), rate->laps).ptr);
+            out += '/';
+            out.append(buf, std::to_chars(buf, buf + sizeof(buf), target_laps).ptr);
+            out += " laps, ";
+            out.append(buf, std::to_chars(buf, buf + sizeof(buf), lapsPerSecond(), std::chars_format::fixed, 2).ptr);
+            out += " laps/s";
+        }
+        out += "  ETA ";
+        std::int64_t eta = etaNs(elapsed_ns);
+        if (eta < 0) {
+            out += "--";
+        } else {
+            append_duration(out, eta, format);
+        }
+    }
+};
+
+// One display frame: the status line and, when a bar is given, the progress
+// bar, built in a single buffer so it can go out in one write.
+inline void render_status(std::string& out, std::int64_t ns, StatusState state, ProgressBar* bar,
+                          TimeFormat format = TimeFormat::MinutesSeconds) {
+    out.clear();
+    append_elapsed(out, ns, format);
+    out += " (";
+    out += to_string(state);
+    out += ")\n";
+    if (!bar) {
+        return;
+    }
+    out += "\n";
+    bar->render(out, ns, format);
+    out += '\n';
+}
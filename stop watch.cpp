@@ -6,86 +6,190 @@
 #include <atomic>
 #include <mutex>
 #include <vector>
-#include <fstream>
 #include <sstream>
+#include <string_view>
 #include <stdexcept>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <deque>
+#include <condition_variable>
+
+#include "async_log.h"
+#include "clock_sync.h"
+#include "cpu_affinity.h"
+#include "frame_pacer.h"
+#include "lap_events.h"
+#include "lap_journal.h"
+#include "lap_sampler.h"
+#include "metrics_reporter.h"
+#include "status_display.h"
+#include "stopwatch_clock.h"
+#include "stopwatch_config.h"
+#include "stopwatch_lanes.h"
+#include "stopwatch_state.h"
+
+const char* const CONFIG_PATH = "stopwatch_config.txt";
+
+struct LapRecord {
+    std::chrono::duration<double> elapsed;
+    int cpu;
+    std::uint32_t cpu_khz;
+    // Stopwatch clock reading when the lap was taken; mapped to wall-clock
+    // time through the clock's anchor on export.
+    StopwatchClock::time_point at;
+    // Lap numbers have gaps when laps are sampled.
+    std::uint64_t number;
+};
 
 class Stopwatch {
 private:
-    std::chrono::steady_clock::time_point start_time;
-    std::chrono::duration<double> elapsed_time;
-    std::atomic<bool> is_running;
-    std::atomic<bool> is_paused;
-    std::atomic<bool> display_running;
-    std::chrono::duration<double> display_interval;
+    // Hot state, written by start/stop/pause/lap on the controlling thread.
+    // Run state and elapsed time change by CAS on one word; mtx orders the
+    // side effects (display thread, laps, journal) that go with them.
+    alignas(64) AtomicStopwatchState state;
     std::mutex mtx;
+    std::uint64_t lap_count;
+    std::deque<LapRecord> laps;
+    LapSampler sampler;
+    bool sample_armed = false;
+    std::uint32_t sample_weight = 1;
+    std::int64_t sample_start_ns = 0;
+    // Elapsed time at the previous recorded lap, for the split sent to the
+    // metrics reporter; -1 when laps since then went unrecorded.
+    std::int64_t last_lap_ns = 0;
+    // Set when the journal needs a new clock map before the next lap: after
+    // a start or resume, a domain change, or a newer sync estimate than
+    // clock_map_generation.
+    bool clock_map_stale = true;
+    std::uint64_t clock_map_generation = 0;
+    // The progress bar's lap rate; updated per lap here rather than in the
+    // bar, which lives on the display line.
+    LapRate lap_rate;
+
+    // Read-mostly: changed on setup or a config reload, read on every tick
+    // and lap. Kept off the hot lines so state changes don't invalidate them.
+    alignas(64) SettingsSlot settings;
+    StopwatchClock clock;
+    LapEventBus* event_bus;
+    std::uint64_t event_source;
+    AsyncLog* async_log;
+    MetricsReporter* metrics = nullptr;
+    ClockSync* clock_sync = nullptr;
+    std::size_t metrics_timer = 0;
+    std::unique_ptr<LapJournal> journal;
+    // Set once by setLaneCount() and kept until destruction; lane_set
+    // publishes it to the lock-free lane calls.
+    std::unique_ptr<StopwatchLanes> lanes;
+    std::atomic<StopwatchLanes*> lane_set{nullptr};
+    std::vector<int> display_cpus;
+    bool display_realtime;
+    StopwatchConfig config;
+    StopwatchConfig saved_config;
+    std::unique_ptr<ConfigWatcher> config_watcher;
+
+    // Display state, written by the display thread on every frame (and by
+    // an on-demand display(), under mtx). Menu output elsewhere uses its own
+    // buffers.
+    alignas(64) std::atomic<bool> display_running;
+    std::mutex ticker_mtx;
+    std::condition_variable ticker_cv;
     std::thread display_thread;
-    std::vector<std::chrono::duration<double>> laps;
+    std::string frame;
+    ProgressBar progress;
+    // Written by the display thread just before it exits; read after join.
+    std::uint64_t frames_rendered = 0;
+    std::uint64_t frames_dropped = 0;
+    double frame_cost = 0.0;
 
 public:
-    Stopwatch() : elapsed_time(0), is_running(false), is_paused(false), display_running(false), display_interval(std::chrono::seconds(1)) {
+    Stopwatch() : lap_count(0), settings(std::make_shared<const DisplaySettings>()), event_bus(nullptr), event_source(0), async_log(nullptr), display_realtime(false), display_running(false) {
+        progress.setLapRate(&lap_rate);
         try {
             loadConfig();
         } catch (const std::exception& e) {
             std::cerr << "Error loading config: " << e.what() << std::endl;
             std::cerr << "Using default display interval of 1 second." << std::endl;
         }
+        saved_config = config;
+        try {
+            config_watcher = std::make_unique<ConfigWatcher>(CONFIG_PATH, [this](const StopwatchConfig& updated) {
+                std::lock_guard<std::mutex> lock(mtx);
+                if (!(updated == config)) {
+                    applyConfig(updated);
+                    saved_config = updated;
+                    std::cout << "Config reloaded." << std::endl;
+                }
+            });
+        } catch (const std::exception& e) {
+            std::cerr << "Config changes will not be picked up live: " << e.what() << std::endl;
+        }
     }
 
     ~Stopwatch() {
+        config_watcher.reset();
         stopDisplayThread();
-        try {
-            saveConfig();
-        } catch (const std::exception& e) {
-            std::cerr << "Error saving config: " << e.what() << std::endl;
+        // Only write back what this process changed, so instances sharing a
+        // working directory don't overwrite each other on exit.
+        if (!(config == saved_config)) {
+            try {
+                save_config_file(CONFIG_PATH, config);
+            } catch (const std::exception& e) {
+                std::cerr << "Error saving config: " << e.what() << std::endl;
+            }
         }
     }
 
     void start() {
         std::lock_guard<std::mutex> lock(mtx);
-        if (!is_running) {
-            start_time = std::chrono::steady_clock::now();
-            is_running = true;
-            is_paused = false;
-            std::cout << "Stopwatch started." << std::endl;
-            startDisplayThread();
-        } else if (is_paused) {
-            start_time = std::chrono::steady_clock::now();
-            is_paused = false;
-            std::cout << "Stopwatch resumed." << std::endl;
-        } else {
-            std::cout << "Stopwatch is already running." << std::endl;
+        StateResult result = state.start(clock.now());
+        switch (result.change) {
+            case StateChange::Started:
+                clock.reanchor();
+                clock_map_stale = true;
+                if (sampler.active()) {
+                    armSample(result.elapsed_ns, true);
+                }
+                report(LogEvent::Started);
+                startDisplayThread();
+                break;
+            case StateChange::Resumed:
+                clock_map_stale = true;
+                report(LogEvent::Resumed);
+                // pause() stopped the display thread.
+                startDisplayThread();
+                break;
+            default:
+                report(LogEvent::AlreadyRunning);
+                break;
         }
     }
 
     void stop() {
         std::lock_guard<std::mutex> lock(mtx);
-        if (is_running && !is_paused) {
-            auto end_time = std::chrono::steady_clock::now();
-            elapsed_time += std::chrono::duration_cast<std::chrono::duration<double>>(end_time - start_time);
-            is_running = false;
-            is_paused = false;
+        StateResult result = state.stop(clock.now());
+        if (result.change == StateChange::Stopped) {
             stopDisplayThread();
-            displayFormattedTime(elapsed_time.count());
-            std::cout << " (Stopwatch stopped)" << std::endl;
+            pauseLanes();
+            flushJournal();
+            report(LogEvent::Stopped, ns_to_seconds(result.elapsed_ns));
         } else {
-            std::cout << "Stopwatch is not running." << std::endl;
+            report(LogEvent::NotRunning);
         }
     }
 
     void pause() {
         std::lock_guard<std::mutex> lock(mtx);
-        if (is_running && !is_paused) {
-            auto end_time = std::chrono::steady_clock::now();
-            elapsed_time += std::chrono::duration_cast<std::chrono::duration<double>>(end_time - start_time);
-            is_paused = true;
+        StateResult result = state.pause(clock.now());
+        if (result.change == StateChange::Paused) {
             stopDisplayThread();
-            displayFormattedTime(elapsed_time.count());
-            std::cout << " (Stopwatch paused)" << std::endl;
-        } else if (is_paused) {
-            std::cout << "Stopwatch is already paused." << std::endl;
+            flushJournal();
+            report(LogEvent::Paused, ns_to_seconds(result.elapsed_ns));
+        } else if (result.change == StateChange::AlreadyPaused) {
+            report(LogEvent::AlreadyPaused);
         } else {
-            std::cout << "Stopwatch is not running." << std::endl;
+            report(LogEvent::NotRunning);
         }
     }
 
@@ -95,11 +199,18 @@ public:
         char confirm;
         std::cin >> confirm;
         if (confirm == 'y' || confirm == 'Y') {
-            elapsed_time = std::chrono::duration<double>::zero();
-            is_running = false;
-            is_paused = false;
+            state.reset(clock.now());
             stopDisplayThread();
             laps.clear();
+            lap_count = 0;
+            sample_armed = false;
+            last_lap_ns = 0;
+            lap_rate.reset();
+            if (lanes) {
+                for (std::size_t i = 0; i < lanes->size(); ++i) {
+                    lanes->reset(i);
+                }
+            }
             std::cout << "Stopwatch reset." << std::endl;
         } else {
             std::cout << "Reset cancelled." << std::endl;
@@ -108,130 +219,522 @@ public:
 
     void display() {
         std::lock_guard<std::mutex> lock(mtx);
-        if (is_running && !is_paused) {
-            auto current_time = std::chrono::steady_clock::now();
-            auto current_elapsed = elapsed_time + std::chrono::duration_cast<std::chrono::duration<double>>(current_time - start_time);
-            displayFormattedTime(current_elapsed.count());
-            std::cout << " (Running)" << std::endl;
-            displayProgressBar(current_elapsed.count());
-        } else if (is_paused) {
-            displayFormattedTime(elapsed_time.count());
-            std::cout << " (Paused)" << std::endl;
-            displayProgressBar(elapsed_time.count());
-        } else {
-            displayFormattedTime(elapsed_time.count());
-            std::cout << " (Stopped)" << std::endl;
-            displayProgressBar(elapsed_time.count());
-        }
+        displayStatus();
     }
 
     void setDisplayInterval(double seconds) {
-        const double MIN_INTERVAL = 0.1;
-        const double MAX_INTERVAL = 60.0;
-        
-        if (seconds >= MIN_INTERVAL && seconds <= MAX_INTERVAL) {
-            display_interval = std::chrono::duration<double>(seconds);
+        std::lock_guard<std::mutex> lock(mtx);
+        if (applyDisplayInterval(seconds)) {
             std::cout << "Display interval set to " << seconds << " seconds." << std::endl;
-        } else {
-            std::cout << "Invalid interval. Please enter a number between " 
-                      << MIN_INTERVAL << " and " << MAX_INTERVAL << " seconds." << std::endl;
         }
     }
 
+    // Steady reads the full-resolution clock; Coarse and Cached trade it for
+    // millisecond resolution and a much cheaper read in start/stop/lap (see
+    // stopwatch_clock.h). Applies to this stopwatch only and can be changed
+    // while it runs.
+    void setClockSource(ClockSource source) {
+        std::lock_guard<std::mutex> lock(mtx);
+        config.clock_source = source;
+        clock.setSource(source);
+    }
+
+    // Boottime keeps counting while the system is suspended, so a stopwatch
+    // running across a suspend reports the real time that passed; Monotonic
+    // (the default) does not. Elapsed time carries on from the current
+    // reading when the domain changes.
+    void setClockDomain(ClockDomain domain) {
+        std::lock_guard<std::mutex> lock(mtx);
+        config.clock_domain = domain;
+        clock_map_stale |= domain != clock.domain();
+        clock.setDomain(domain);
+    }
+
+    ClockDomain clockDomain() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return clock.domain();
+    }
+
+    // Maps journaled laps onto the sync's reference clock (see
+    // JournalClockMap), so the analysis tool can align them with other
+    // processes' journals. The sync has to measure this stopwatch's clock
+    // domain; until it does, laps are mapped to wall-clock time instead.
+    void setClockSync(ClockSync* sync) {
+        std::lock_guard<std::mutex> lock(mtx);
+        clock_sync = sync;
+        clock_map_stale = true;
+    }
+
+    // Pins the display thread to the given cores and optionally asks for
+    // SCHED_FIFO. Takes effect the next time the display thread starts.
+    void setDisplayAffinity(const std::vector<int>& cpus, bool realtime) {
+        std::lock_guard<std::mutex> lock(mtx);
+        display_cpus = cpus;
+        display_realtime = realtime;
+    }
+
+    // Every recorded lap is also published to the bus; subscribers run on the
+    // bus's consumer thread, never inside lap().
+    void setLapEventBus(LapEventBus* bus, std::uint64_t source) {
+        std::lock_guard<std::mutex> lock(mtx);
+        event_bus = bus;
+        event_source = source;
+    }
+
+    // Routes start/stop/pause/lap messages to a background writer instead of
+    // formatting them on the calling thread. The log follows the configured
+    // time format, including on reloads.
+    void setAsyncLog(AsyncLog* log) {
+        std::lock_guard<std::mutex> lock(mtx);
+        async_log = log;
+        if (async_log) {
+            async_log->setTimeFormat(settings.load()->time_format);
+        }
+    }
+
+    // Reports every recorded lap's split to a collector under the given
+    // timer name, weighted like the journal when laps are sampled.
+    void setMetricsReporter(MetricsReporter* reporter, std::string_view timer_name) {
+        std::lock_guard<std::mutex> lock(mtx);
+        metrics_timer = reporter ? reporter->timer(timer_name) : 0;
+        metrics = reporter;
+    }
+
+    // Persists every subsequent lap to a journal file; segments are flushed
+    // and synced when the stopwatch is stopped or paused.
+    void enableJournal(const std::string& path, JournalBackendKind kind = JournalBackendKind::Auto) {
+        std::lock_guard<std::mutex> lock(mtx);
+        try {
+            journal = std::make_unique<LapJournal>(path, event_source, kind);
+            clock_map_stale = true;
+            std::cout << "Journaling laps to " << path << " using " << journal->backendName() << "." << std::endl;
+        } catch (const std::exception& e) {
+            std::cerr << "Error opening journal: " << e.what() << std::endl;
+        }
+    }
+
+    // Splits the stopwatch into lanes for concurrent segments of the same
+    // operation. Call before handing lanes to worker threads; after that,
+    // startLane()/pauseLane() and laneSummary() are lock-free and may be used
+    // from any thread. Stopping the stopwatch pauses every lane. The lanes
+    // can be set only once, since worker threads may still be using them;
+    // before that, the lane calls do nothing.
+    void setLaneCount(std::size_t count) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (lanes) {
+            throw std::logic_error("Lanes are already set");
+        }
+        lanes = std::make_unique<StopwatchLanes>(count, clock.now());
+        lane_set.store(lanes.get(), std::memory_order_release);
+    }
+
+    bool startLane(std::size_t lane) {
+        StopwatchLanes* set = lane_set.load(std::memory_order_acquire);
+        return set && set->start(lane, clock.now());
+    }
+
+    bool pauseLane(std::size_t lane) {
+        StopwatchLanes* set = lane_set.load(std::memory_order_acquire);
+        return set && set->pause(lane, clock.now());
+    }
+
+    std::int64_t laneElapsedNs(std::size_t lane) const {
+        StopwatchLanes* set = lane_set.load(std::memory_order_acquire);
+        return set ? set->elapsedNs(lane, clock.now()) : 0;
+    }
+
+    LaneSummary laneSummary() const {
+        StopwatchLanes* set = lane_set.load(std::memory_order_acquire);
+        return set ? set->summary(clock.now()) : LaneSummary{};
+    }
+
+    void displayLanes() {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!lanes || lanes->size() == 0) {
+            std::cout << "No lanes configured." << std::endl;
+            return;
+        }
+        auto now = clock.now();
+        std::int64_t wall = state.elapsedNs(now);
+        TimeFormat format = settings.load()->time_format;
+        LaneSummary summary = lanes->summary(now);
+        std::string text;
+        for (std::size_t i = 0; i < lanes->size(); ++i) {
+            text += "Lane ";
+            text += std::to_string(i);
+            text += ": ";
+            append_elapsed(text, lanes->elapsedNs(i, now), format);
+            text += lanes->running(i) ? " (Running)\n" : "\n";
+        }
+        text += "Wall: ";
+        append_duration(text, wall, format);
+        text += ", sum of lanes: ";
+        append_duration(text, summary.sum_ns, format);
+        text += ", critical lane ";
+        text += std::to_string(summary.critical_lane);
+        text += " (";
+        append_duration(text, summary.max_ns, format);
+        text += "), imbalance ";
+        char buf[32];
+        text.append(buf, std::to_chars(buf, buf + sizeof(buf), summary.imbalance, std::chars_format::fixed, 2).ptr);
+        text += "x\n";
+        std::cout << text << std::flush;
+    }
+
     void lap() {
         std::lock_guard<std::mutex> lock(mtx);
-        if (is_running && !is_paused) {
-            auto current_time = std::chrono::steady_clock::now();
-            auto current_elapsed = elapsed_time + std::chrono::duration_cast<std::chrono::duration<double>>(current_time - start_time);
-            laps.push_back(current_elapsed);
-            std::cout << "Lap " << laps.size() << ": ";
-            displayFormattedTime(current_elapsed.count());
-            std::cout << std::endl;
-        } else {
-            std::cout << "Cannot record lap: Stopwatch is not running." << std::endl;
+        StateSnapshot snapshot = state.load();
+        if (snapshot.state != RunState::Running) {
+            report(LogEvent::LapRejected);
+            return;
+        }
+        ++lap_count;
+        if (!sampler.active()) {
+            auto now = clock.now();
+            recordLap(snapshot.elapsedNs(state.ticks(now)), now, -1);
+            return;
+        }
+        // A lap is the interval since the previous lap() call, so taking one
+        // needs the clock at both ends: the sampler decides one lap ahead and
+        // only an armed interval reads the clock again when it ends. Laps
+        // that are neither armed nor ending an armed interval cost only the
+        // sampler's countdown.
+        if (sample_armed) {
+            // The budget is checked against steady_clock whatever the clock
+            // source: a coarse or cached read can't resolve one lap's cost.
+            auto cost_start = std::chrono::steady_clock::now();
+            auto now = clock.now();
+            std::int64_t elapsed_ns = snapshot.elapsedNs(state.ticks(now));
+            recordLap(elapsed_ns, now, elapsed_ns - sample_start_ns);
+            sample_armed = false;
+            auto done = std::chrono::steady_clock::now();
+            sampler.recorded((done - cost_start).count(), done.time_since_epoch().count());
+            armSample(elapsed_ns, true);
+        } else if (sampler.sample()) {
+            armSample(snapshot.elapsedNs(state.ticks(clock.now())), false);
         }
     }
 
+    // Records 1 in N laps instead of every lap, with the laps that are kept
+    // weighted by N so statistics in the analysis tool stay unbiased. With a
+    // budget (a fraction of elapsed time, e.g. 0.01), N is adjusted on the fly
+    // to keep the time spent recording laps under it. Rate 1 and no budget
+    // records every lap.
+    void setLapSampling(std::uint32_t rate, double budget) {
+        std::lock_guard<std::mutex> lock(mtx);
+        config.lap_sample_rate = rate;
+        config.lap_sample_budget = budget;
+        applyLapSampling();
+    }
     void displayLaps() {
         std::lock_guard<std::mutex> lock(mtx);
         if (laps.empty()) {
             std::cout << "No laps recorded." << std::endl;
+        } else if (settings.load()->output_format == OutputFormat::Csv) {
+            const ClockAnchor& anchor = clock.anchor();
+            std::cout << "lap,elapsed_seconds,cpu,cpu_khz,wall_time" << std::endl;
+            std::string timestamp;
+            for (size_t i = 0; i < laps.size(); ++i) {
+                timestamp.clear();
+                append_utc_timestamp(timestamp, anchor.realtimeNs(laps[i].at));
+                std::cout << laps[i].number << "," << std::fixed << std::setprecision(6) << laps[i].elapsed.count()
+                          << "," << laps[i].cpu << "," << laps[i].cpu_khz << "," << timestamp << std::endl;
+            }
         } else {
             std::cout << "Recorded Laps:" << std::endl;
+            if (sampler.active()) {
+                std::cout << "(sampling 1 in " << sampler.rate() << " of " << lap_count << " laps)" << std::endl;
+            }
             for (size_t i = 0; i < laps.size(); ++i) {
-                std::cout << "Lap " << i + 1 << ": ";
-                displayFormattedTime(laps[i].count());
+                std::cout << "Lap " << laps[i].number << ": ";
+                displayFormattedTime(laps[i].elapsed.count());
+                displayLapCpu(i);
                 std::cout << std::endl;
             }
         }
     }
 
 private:
+    // split_ns is the lap's own duration for a sampled lap, -1 otherwise.
+    void recordLap(std::int64_t elapsed_ns, StopwatchClock::time_point now, std::int64_t split_ns) {
+        std::chrono::duration<double> current_elapsed(ns_to_seconds(elapsed_ns));
+        int cpu = current_cpu();
+        laps.push_back({current_elapsed, cpu, CpuFrequency::instance().khz(cpu), now, lap_count});
+        lap_rate.record(elapsed_ns, lap_count);
+        trimLaps();
+        if (journal) {
+            try {
+                if (clock_map_stale || (clock_sync && clock_sync->generation() != clock_map_generation)) {
+                    writeClockMap(elapsed_ns, now);
+                }
+                if (split_ns >= 0) {
+                    journal->appendSampled({elapsed_ns, split_ns, lap_count, cpu, sample_weight});
+                } else {
+                    journal->setNextLap(lap_count);
+                    journal->append({elapsed_ns, cpu, laps.back().cpu_khz});
+                }
+            } catch (const std::exception& e) {
+                std::cerr << "Error writing journal: " << e.what() << std::endl;
+                journal.reset();
+            }
+        }
+        if (event_bus) {
+            event_bus->publish({event_source, lap_count, std::chrono::nanoseconds(elapsed_ns), cpu});
+        }
+        if (metrics) {
+            if (split_ns >= 0) {
+                metrics->record(metrics_timer, split_ns, sample_weight);
+            } else if (last_lap_ns >= 0) {
+                metrics->record(metrics_timer, elapsed_ns - last_lap_ns);
+            }
+        }
+        last_lap_ns = split_ns >= 0 ? -1 : elapsed_ns;
+        report(LogEvent::Lap, current_elapsed.count(), static_cast<std::uint32_t>(lap_count));
+    }
+
+    // Records where the laps from here on sit on the reference timeline: the
+    // collector's clock when the sync measures this stopwatch's domain,
+    // otherwise wall-clock time through the anchor.
+    void writeClockMap(std::int64_t elapsed_ns, StopwatchClock::time_point now) {
+        const ClockAnchor& anchor = clock.anchor();
+        JournalClockMap map{};
+        map.elapsed_ns = elapsed_ns;
+        map.local_ns = clock.domainNs(now);
+        map.realtime_ns = anchor.realtimeNs(now);
+        map.domain = static_cast<std::uint32_t>(clock.domain());
+        // Generation first, so an estimate that lands in between is picked
+        // up with the next lap rather than missed.
+        clock_map_generation = clock_sync ? clock_sync->generation() : 0;
+        ClockMapping mapping = clock_sync ? clock_sync->mapping() : ClockMapping();
+        if (mapping.valid() && mapping.domain == clock.domain()) {
+            map.reference_id = mapping.reference_id;
+            map.reference_ns = mapping.toReference(map.local_ns);
+            map.skew = mapping.skew;
+            map.uncertainty_ns = mapping.uncertainty_ns;
+        } else {
+            map.reference_ns = map.realtime_ns;
+            map.uncertainty_ns = anchor.uncertainty_ns;
+        }
+        journal->appendClockMap(map);
+        clock_map_stale = false;
+    }
+
+    // Asks the sampler whether the lap starting at elapsed_ns is to be
+    // recorded. consult is false when the caller has already asked.
+    void armSample(std::int64_t elapsed_ns, bool consult) {
+        if (consult && !sampler.sample()) {
+            return;
+        }
+        sample_armed = true;
+        sample_start_ns = elapsed_ns;
+        sample_weight = sampler.weight();
+    }
+
+    void applyLapSampling() {
+        if (sampler.active()) {
+            last_lap_ns = -1;
+        }
+        sampler.setRate(config.lap_sample_rate);
+        sampler.setBudget(config.lap_sample_budget);
+        sample_armed = false;
+    }
+
+    bool applyDisplayInterval(double seconds) {
+        const double MIN_INTERVAL = 0.001;
+        const double MAX_INTERVAL = 60.0;
+        
+        if (seconds >= MIN_INTERVAL && seconds <= MAX_INTERVAL) {
+            config.display_interval = seconds;
+            publishSettings();
+            return true;
+        }
+        std::cout << "Invalid interval. Please enter a number between " 
+                  << MIN_INTERVAL << " and " << MAX_INTERVAL << " seconds." << std::endl;
+        return false;
+    }
+
+    void applyConfig(const StopwatchConfig& updated) {
+        applyDisplayInterval(updated.display_interval);
+        config.clock_source = updated.clock_source;
+        config.clock_domain = updated.clock_domain;
+        clock.setSource(config.clock_source);
+        clock_map_stale |= config.clock_domain != clock.domain();
+        clock.setDomain(config.clock_domain);
+        config.max_laps = updated.max_laps;
+        config.output_format = updated.output_format;
+        config.show_progress_bar = updated.show_progress_bar;
+        config.live_display = updated.live_display;
+        config.time_format = updated.time_format;
+        config.target_duration = updated.target_duration;
+        config.target_laps = updated.target_laps;
+        config.progress_style = updated.progress_style;
+        if (updated.lap_sample_rate != config.lap_sample_rate || updated.lap_sample_budget != config.lap_sample_budget) {
+            config.lap_sample_rate = updated.lap_sample_rate;
+            config.lap_sample_budget = updated.lap_sample_budget;
+            applyLapSampling();
+        }
+        trimLaps();
+        publishSettings();
+    }
+
+    // Builds a new immutable settings snapshot from config and swaps it in;
+    // the display thread is woken so a new interval applies to the next tick
+    // instead of after the current sleep.
+    void publishSettings() {
+        auto next = std::make_shared<DisplaySettings>();
+        next->interval = std::chrono::duration<double>(config.display_interval);
+        next->output_format = config.output_format;
+        next->show_progress_bar = config.show_progress_bar;
+        next->live_display = config.live_display;
+        next->time_format = config.time_format;
+        next->target_ns = seconds_to_ns(config.target_duration);
+        next->target_laps = config.target_laps;
+        next->progress_style = config.progress_style;
+        if (async_log) {
+            async_log->setTimeFormat(next->time_format);
+        }
+        settings.store(std::move(next));
+        {
+            std::lock_guard<std::mutex> lock(ticker_mtx);
+        }
+        ticker_cv.notify_all();
+    }
+
+    void trimLaps() {
+        while (config.max_laps > 0 && laps.size() > config.max_laps) {
+            laps.pop_front();
+        }
+    }
+
+    void pauseLanes() {
+        if (lanes) {
+            auto now = clock.now();
+            for (std::size_t i = 0; i < lanes->size(); ++i) {
+                lanes->pause(i, now);
+            }
+        }
+    }
+
+    void flushJournal() {
+        if (!journal) {
+            return;
+        }
+        try {
+            journal->flush();
+        } catch (const std::exception& e) {
+            std::cerr << "Error writing journal: " << e.what() << std::endl;
+            journal.reset();
+        }
+    }
+
+    void report(LogEvent event, double seconds = 0.0, std::uint32_t lap_number = 0) {
+        if (async_log) {
+            async_log->log(event, static_cast<std::uint32_t>(event_source), seconds, lap_number);
+            return;
+        }
+        std::string line;
+        format_log_record({seconds, 0, lap_number, event}, line, settings.load()->time_format);
+        std::cout << line << std::endl;
+    }
+
+    void displayStatus() {
+        auto current = settings.load();
+        progress.configure(current->progress_style, current->target_ns, current->target_laps);
+        ProgressBar* bar = current->show_progress_bar ? &progress : nullptr;
+        StateSnapshot snapshot = state.load();
+        std::int64_t elapsed = snapshot.elapsedNs(state.ticks(clock.now()));
+        StatusState status = snapshot.state == RunState::Running ? StatusState::Running
+                           : snapshot.state == RunState::Paused ? StatusState::Paused : StatusState::Stopped;
+        render_status(frame, elapsed, status, bar, current->time_format);
+        std::cout.write(frame.data(), static_cast<std::streamsize>(frame.size()));
+        std::cout.flush();
+    }
+
     void displayFormattedTime(double seconds) {
-        int minutes = static_cast<int>(seconds) / 60;
-        seconds = std::fmod(seconds, 60.0);
-        std::cout << "Elapsed time: " << std::setfill('0') << std::setw(2) << minutes << ":" 
-                  << std::setfill('0') << std::setw(5) << std::fixed << std::setprecision(2) << seconds;
+        std::string text;
+        append_elapsed(text, seconds_to_ns(seconds), settings.load()->time_format);
+        std::cout << text;
     }
 
-    void displayProgressBar(double seconds) {
-        const int barWidth = 50;
-        int progress = static_cast<int>((seconds / 60) * barWidth) % barWidth;
-        std::cout << "\n[";
-        for (int i = 0; i < barWidth; ++i) {
-            if (i < progress) std::cout << "=";
-            else if (i == progress) std::cout << ">";
-            else std::cout << " ";
+    void displayLapCpu(size_t index) {
+        const LapRecord& record = laps[index];
+        if (record.cpu < 0) {
+            return;
+        }
+        std::cout << " [cpu " << record.cpu;
+        if (record.cpu_khz > 0) {
+            std::cout << " @ " << record.cpu_khz / 1000 << " MHz";
         }
-        std::cout << "] " << static_cast<int>(seconds) % 60 << "s" << std::endl;
+        if (index > 0 && laps[index - 1].cpu >= 0 && laps[index - 1].cpu != record.cpu) {
+            std::cout << ", migrated from cpu " << laps[index - 1].cpu;
+        }
+        std::cout << "]";
     }
 
     void startDisplayThread() {
         stopDisplayThread();
         display_running = true;
-        display_thread = std::thread([this]() {
+        display_thread = std::thread([this, cpus = display_cpus, realtime = display_realtime]() {
+            pin_current_thread(cpus);
+            if (realtime) {
+                raise_thread_priority();
+            }
+            auto current = settings.load();
+            FramePacer pacer(std::chrono::duration_cast<FramePacer::clock::duration>(current->interval));
+            bool budget_warned = false;
             while (display_running) {
-                {
-                    std::lock_guard<std::mutex> lock(mtx);
-                    if (is_running && !is_paused) {
-                        display();
+                if (current->live_display) {
+                    // start()/stop() hold mtx while joining this thread, so
+                    // never block on it here; a contended tick is skipped.
+                    std::unique_lock<std::mutex> lock(mtx, std::try_to_lock);
+                    if (!lock.owns_lock()) {
+                        pacer.frameDropped();
+                    } else if (state.load().state == RunState::Running) {
+                        auto frame_start = FramePacer::clock::now();
+                        displayStatus();
+                        pacer.frameRendered(FramePacer::clock::now() - frame_start);
+                    }
+                }
+                if (pacer.overBudget() && !budget_warned) {
+                    budget_warned = true;
+                    std::cout << "Display cannot sustain " << std::lround(1.0 / current->interval.count())
+                              << " Hz; refreshing at " << std::lround(1.0 / std::chrono::duration<double>(pacer.period()).count()) << " Hz." << std::endl;
+                }
+                pacer.advance(FramePacer::clock::now());
+                std::unique_lock<std::mutex> lock(ticker_mtx);
+                while (display_running && FramePacer::clock::now() < pacer.nextDeadline()) {
+                    ticker_cv.wait_until(lock, pacer.nextDeadline());
+                    auto latest = settings.load();
+                    if (latest != current) {
+                        current = std::move(latest);
+                        pacer.setTarget(std::chrono::duration_cast<FramePacer::clock::duration>(current->interval));
                     }
                 }
-                std::this_thread::sleep_for(display_interval);
             }
+            frames_rendered = pacer.renderedFrames();
+            frames_dropped = pacer.droppedFrames();
+            frame_cost = pacer.frameCostSeconds();
         });
     }
 
     void stopDisplayThread() {
-        display_running = false;
+        {
+            std::lock_guard<std::mutex> lock(ticker_mtx);
+            display_running = false;
+        }
+        ticker_cv.notify_all();
         if (display_thread.joinable()) {
             display_thread.join();
-        }
-    }
-
-    void saveConfig() {
-        std::ofstream config_file("stopwatch_config.txt");
-        if (config_file.is_open()) {
-            config_file << display_interval.count() << std::endl;
-            config_file.close();
-        } else {
-            throw std::runtime_error("Unable to open config file for writing");
+            if (frames_dropped > 0) {
+                std::cout << "Display dropped " << frames_dropped << " of " << frames_rendered + frames_dropped
+                          << " frames (" << std::fixed << std::setprecision(2) << frame_cost * 1000.0
+                          << " ms per frame)." << std::endl;
+            }
         }
     }
 
     void loadConfig() {
-        std::ifstream config_file("stopwatch_config.txt");
-        if (config_file.is_open()) {
-            double interval;
-            if (config_file >> interval) {
-                setDisplayInterval(interval);
-            } else {
-                throw std::runtime_error("Invalid data in config file");
-            }
-            config_file.close();
-        } else {
-            throw std::runtime_error("Unable to open config file for reading");
-        }
+        applyConfig(load_config_file(CONFIG_PATH));
     }
 };
 
@@ -278,22 +781,48 @@ int get_menu_choice() {
 double get_valid_interval() {
     double interval;
     while (true) {
-        std::cout << "Enter new display interval in seconds (0.1 to 60): ";
+        std::cout << "Enter new display interval in seconds (0.001 to 60): ";
         if (std::cin >> interval) {
-            if (interval >= 0.1 && interval <= 60) {
+            if (interval >= 0.001 && interval <= 60) {
                 return interval;
             }
         }
-        std::cout << "Invalid input. Please enter a number between 0.1 and 60." << std::endl;
+        std::cout << "Invalid input. Please enter a number between 0.001 and 60." << std::endl;
         std::cin.clear();
         std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
     }
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    // Declared first so they outlive the stopwatch that uses them.
+    std::unique_ptr<MetricsReporter> metrics;
+    std::unique_ptr<ClockSync> clock_sync;
     Stopwatch stopwatch;
     int choice;
 
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--journal" && i + 1 < argc) {
+            stopwatch.enableJournal(argv[++i]);
+        } else if (arg == "--collector" && i + 1 < argc) {
+            try {
+                metrics = std::make_unique<MetricsReporter>(argv[++i]);
+                stopwatch.setMetricsReporter(metrics.get(), "stopwatch/lap");
+            } catch (const std::exception& e) {
+                std::cerr << "Error connecting to collector: " << e.what() << std::endl;
+            }
+        } else if (arg == "--clock-sync" && i + 1 < argc) {
+            try {
+                clock_sync = std::make_unique<ClockSync>(argv[++i], stopwatch.clockDomain());
+                stopwatch.setClockSync(clock_sync.get());
+            } catch (const std::exception& e) {
+                std::cerr << "Error starting clock sync: " << e.what() << std::endl;
+            }
+        } else {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+        }
+    }
+
     std::cout << "Welcome to the Robust C++ Stopwatch!" << std::endl;
     std::cout << "Type 9 for help on how to use the stopwatch." << std::endl;
 
@@ -0,0 +1,552 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "async_log.h"
+#include "lap_journal.h"
+#include "lap_stats.h"
+#include "stopwatch_clock.h"
+
+// Read-only view of a journal file. Segments are located by walking headers,
+// which touches one page per segment; payloads are only read by the workers.
+class MappedJournal {
+private:
+    int fd = -1;
+    const std::uint8_t* data = nullptr;
+    std::size_t size = 0;
+
+public:
+    std::string path;
+    std::vector<std::size_t> segments;
+
+    explicit MappedJournal(const std::string& file) : path(file) {
+        fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::runtime_error("Unable to open " + file + ": " + std::strerror(errno));
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Unable to stat " + file + ": " + std::strerror(errno));
+        }
+        size = static_cast<std::size_t>(st.st_size);
+        if (size > 0) {
+            void* p = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("Unable to map " + file + ": " + std::strerror(errno));
+            }
+            data = static_cast<const std::uint8_t*>(p);
+            ::madvise(p, size, MADV_SEQUENTIAL);
+        }
+
+        std::size_t offset = 0;
+        while (offset + sizeof(JournalSegmentHeader) <= size) {
+            JournalSegmentHeader h = header(offset);
+            if (h.magic != JOURNAL_MAGIC || offset + sizeof(JournalSegmentHeader) + h.payload_bytes > size) {
+                std::cerr << file << ": stopping at invalid or truncated segment at offset " << offset << std::endl;
+                break;
+            }
+            segments.push_back(offset);
+            offset += sizeof(JournalSegmentHeader) + h.payload_bytes;
+        }
+    }
+
+    ~MappedJournal() {
+        if (data) {
+            ::munmap(const_cast<std::uint8_t*>(data), size);
+        }
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+    MappedJournal(const MappedJournal&) = delete;
+    MappedJournal& operator=(const MappedJournal&) = delete;
+
+    // Copied out: segments follow variable-length payloads, so a header is
+    // not necessarily aligned in the mapping.
+    JournalSegmentHeader header(std::size_t offset) const {
+        JournalSegmentHeader h;
+        std::memcpy(&h, data + offset, sizeof(h));
+        return h;
+    }
+
+    // The segment's payload, checked against the end of the mapping.
+    const std::uint8_t* payload(std::size_t offset) const {
+        if (offset > size || size - offset < sizeof(JournalSegmentHeader) ||
+            size - offset - sizeof(JournalSegmentHeader) < header(offset).payload_bytes) {
+            throw std::runtime_error("Segment runs past the end of the journal");
+        }
+        return data + offset + sizeof(JournalSegmentHeader);
+    }
+
+    void decode(std::size_t offset, std::vector<JournalRecord>& out) const {
+        const std::uint8_t* bytes = payload(offset);
+        JournalSegmentHeader h = header(offset);
+        if (h.encoding == JOURNAL_ENCODING_GORILLA) {
+            if (h.count > lap_codec_max_records(h.payload_bytes)) {
+                throw std::runtime_error("Corrupt lap segment");
+            }
+            out.resize(h.count);
+            decode_laps(bytes, h.payload_bytes, h.count, out.data());
+        } else if (h.encoding == JOURNAL_ENCODING_RAW && h.payload_bytes == h.count * sizeof(JournalRecord)) {
+            out.resize(h.count);
+            std::memcpy(out.data(), bytes, h.payload_bytes);
+        } else {
+            throw std::runtime_error("Unsupported segment encoding");
+        }
+    }
+
+    void decodeSampled(std::size_t offset, std::vector<SampledJournalRecord>& out) const {
+        const std::uint8_t* bytes = payload(offset);
+        JournalSegmentHeader h = header(offset);
+        if (h.payload_bytes != h.count * sizeof(SampledJournalRecord)) {
+            throw std::runtime_error("Corrupt sampled segment");
+        }
+        out.resize(h.count);
+        std::memcpy(out.data(), bytes, h.payload_bytes);
+    }
+
+    JournalClockMap clockMap(std::size_t offset) const {
+        const std::uint8_t* bytes = payload(offset);
+        if (header(offset).payload_bytes != sizeof(JournalClockMap)) {
+            throw std::runtime_error("Corrupt clock map segment");
+        }
+        JournalClockMap map;
+        std::memcpy(&map, bytes, sizeof(map));
+        return map;
+    }
+};
+
+struct SourceSummary {
+    LapStats splits;
+    LapHistogram histogram;
+    std::int64_t last_elapsed = 0;
+
+    void merge(const SourceSummary& other) {
+        splits.merge(other.splits);
+        histogram.merge(other.histogram);
+        last_elapsed = std::max(last_elapsed, other.last_elapsed);
+    }
+};
+
+// What a worker learned about one segment that it cannot resolve alone: the
+// split of its first lap depends on the last lap of the preceding segment.
+struct SegmentEdge {
+    std::size_t file;
+    std::uint64_t source;
+    std::uint64_t first_lap;
+    std::uint64_t count;
+    std::int64_t first_elapsed;
+    std::int64_t last_elapsed;
+    // Sampled segments carry their own splits and are never stitched.
+    bool sampled;
+};
+
+std::string label_for(const MappedJournal& journal, std::uint64_t source) {
+    return journal.path + " [source " + std::to_string(source) + "]";
+}
+
+std::string format_duration(double ns) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3);
+    if (ns >= 1e9) {
+        out << ns / 1e9 << " s";
+    } else if (ns >= 1e6) {
+        out << ns / 1e6 << " ms";
+    } else if (ns >= 1e3) {
+        out << ns / 1e3 << " us";
+    } else {
+        out << ns << " ns";
+    }
+    return out.str();
+}
+
+void print_laps(const MappedJournal& journal) {
+    std::vector<JournalRecord> records;
+    std::vector<SampledJournalRecord> sampled;
+    std::string line;
+    std::cout << "Recorded Laps (" << journal.path << "):" << std::endl;
+    int previous_cpu = -1;
+    for (std::size_t offset : journal.segments) {
+        if (journal.header(offset).encoding == JOURNAL_ENCODING_CLOCK_MAP) {
+            continue;
+        }
+        if (journal.header(offset).encoding == JOURNAL_ENCODING_SAMPLED) {
+            journal.decodeSampled(offset, sampled);
+            for (const SampledJournalRecord& r : sampled) {
+                line.clear();
+                format_log_record({static_cast<double>(r.elapsed_ns) / 1e9, 0, static_cast<std::uint32_t>(r.lap), LogEvent::Lap}, line);
+                std::cout << line << " (took " << format_duration(static_cast<double>(r.split_ns)) << ", sampled 1 in "
+                          << r.weight << ")\n";
+            }
+            previous_cpu = -1;
+            continue;
+        }
+        journal.decode(offset, records);
+        std::uint64_t lap = journal.header(offset).first_lap;
+        for (const JournalRecord& r : records) {
+            line.clear();
+            format_log_record({static_cast<double>(r.elapsed_ns) / 1e9, 0, static_cast<std::uint32_t>(lap++), LogEvent::Lap}, line);
+            std::cout << line;
+            if (r.cpu >= 0) {
+                std::cout << " [cpu " << r.cpu;
+                if (r.cpu_khz > 0) {
+                    std::cout << " @ " << r.cpu_khz / 1000 << " MHz";
+                }
+                if (previous_cpu >= 0 && previous_cpu != r.cpu) {
+                    std::cout << ", migrated from cpu " << previous_cpu;
+                }
+                std::cout << "]";
+                previous_cpu = r.cpu;
+            }
+            std::cout << '\n';
+        }
+    }
+    std::cout << std::flush;
+}
+
+std::string format_reference_id(std::uint64_t id) {
+    std::ostringstream out;
+    out << std::hex << std::setw(16) << std::setfill('0') << id;
+    return out.str();
+}
+
+void print_clock_map(const JournalClockMap& map) {
+    std::cout << "  Clock: " << to_string(static_cast<ClockDomain>(map.domain)) << " mapped to ";
+    if (map.reference_id != 0) {
+        std::cout << "reference " << format_reference_id(map.reference_id) << ", skew " << std::fixed
+                  << std::setprecision(3) << map.skew * 1e6 << " ppm";
+    } else {
+        std::cout << "wall-clock time (no clock sync)";
+    }
+    std::cout << ", +/- " << format_duration(static_cast<double>(map.uncertainty_ns)) << std::endl;
+}
+
+// Every lap of every journal on one timeline, through the clock maps: on the
+// common reference clock if all journals were synced to the same one,
+// otherwise on wall-clock time. Laps before a journal's first map can't be
+// placed and are only counted.
+void print_timeline(const std::vector<std::unique_ptr<MappedJournal>>& journals) {
+    struct Event {
+        std::int64_t at_ns;
+        std::size_t file;
+        std::uint64_t source;
+        std::uint64_t lap;
+        std::int64_t elapsed_ns;
+    };
+    std::set<std::uint64_t> references;
+    for (const auto& journal : journals) {
+        for (std::size_t offset : journal->segments) {
+            if (journal->header(offset).encoding == JOURNAL_ENCODING_CLOCK_MAP) {
+                references.insert(journal->clockMap(offset).reference_id);
+            }
+        }
+    }
+    bool common = references.size() == 1 && *references.begin() != 0;
+
+    std::vector<Event> events;
+    std::int64_t uncertainty = 0;
+    std::uint64_t unplaced = 0;
+    std::vector<JournalRecord> records;
+    std::vector<SampledJournalRecord> sampled;
+    for (std::size_t f = 0; f < journals.size(); ++f) {
+        const MappedJournal& journal = *journals[f];
+        std::map<std::uint64_t, JournalClockMap> current;
+        auto place = [&](std::uint64_t source, std::uint64_t lap, std::int64_t elapsed_ns) {
+            auto it = current.find(source);
+            if (it == current.end()) {
+                ++unplaced;
+                return;
+            }
+            const JournalClockMap& map = it->second;
+            std::int64_t at = common ? map.referenceNs(elapsed_ns) : map.realtime_ns + (elapsed_ns - map.elapsed_ns);
+            events.push_back({at, f, source, lap, elapsed_ns});
+        };
+        for (std::size_t offset : journal.segments) {
+            JournalSegmentHeader h = journal.header(offset);
+            if (h.encoding == JOURNAL_ENCODING_CLOCK_MAP) {
+                JournalClockMap map = journal.clockMap(offset);
+                uncertainty = std::max(uncertainty, map.uncertainty_ns);
+                current[h.source] = map;
+            } else if (h.encoding == JOURNAL_ENCODING_SAMPLED) {
+                journal.decodeSampled(offset, sampled);
+                for (const SampledJournalRecord& r : sampled) {
+                    place(h.source, r.lap, r.elapsed_ns);
+                }
+            } else {
+                journal.decode(offset, records);
+                for (std::size_t i = 0; i < records.size(); ++i) {
+                    place(h.source, h.first_lap + i, records[i].elapsed_ns);
+                }
+            }
+        }
+    }
+    std::stable_sort(events.begin(), events.end(), [](const Event& a, const Event& b) { return a.at_ns < b.at_ns; });
+
+    if (common) {
+        std::cout << "Timeline on reference clock " << format_reference_id(*references.begin())
+                  << ", aligned to within +/- " << format_duration(static_cast<double>(uncertainty)) << ":" << std::endl;
+    } else {
+        std::cout << "Timeline on wall-clock time (journals not synced to one reference clock), aligned only as well "
+                     "as the hosts' clocks agree:" << std::endl;
+    }
+    std::int64_t origin = events.empty() ? 0 : events.front().at_ns;
+    for (const Event& e : events) {
+        std::cout << "  +" << std::fixed << std::setprecision(3) << std::setw(14)
+                  << static_cast<double>(e.at_ns - origin) / 1e3 << " us  " << label_for(*journals[e.file], e.source)
+                  << "  Lap " << e.lap << " at " << format_duration(static_cast<double>(e.elapsed_ns)) << '\n';
+    }
+    if (unplaced > 0) {
+        std::cout << unplaced << " lap(s) recorded before their journal's first clock map were left out." << '\n';
+    }
+    std::cout << std::flush;
+}
+
+void print_histogram(const LapHistogram& histogram) {
+    // Collapse the fine buckets into one row per power of two.
+    const int barWidth = 50;
+    std::map<std::uint64_t, std::uint64_t> rows;
+    for (unsigned i = 0; i < LapHistogram::BUCKETS; ++i) {
+        if (histogram.bucketCount(i) > 0) {
+            std::uint64_t low = LapHistogram::bucketLowerBound(i);
+            rows[low ? std::uint64_t(1) << (63 - std::countl_zero(low)) : 0] += histogram.bucketCount(i);
+        }
+    }
+    std::uint64_t peak = 0;
+    for (const auto& row : rows) {
+        peak = std::max(peak, row.second);
+    }
+    for (const auto& row : rows) {
+        int width = static_cast<int>(static_cast<double>(row.second) / static_cast<double>(peak) * barWidth);
+        std::cout << "  >= " << std::setw(12) << format_duration(static_cast<double>(row.first)) << " |"
+                  << std::string(width, '=') << " " << row.second << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> paths;
+    bool list_laps = false;
+    bool show_histogram = false;
+    bool timeline = false;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--laps") {
+            list_laps = true;
+        } else if (arg == "--histogram") {
+            show_histogram = true;
+        } else if (arg == "--timeline") {
+            timeline = true;
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = std::max(1, std::atoi(argv[++i]));
+        } else {
+            paths.push_back(arg);
+        }
+    }
+    if (paths.empty()) {
+        std::cerr << "Usage: stopwatch-analyze [--laps | --timeline] [--histogram] [--threads N] journal..." << std::endl;
+        return 1;
+    }
+
+    std::vector<std::unique_ptr<MappedJournal>> journals;
+    try {
+        for (const std::string& path : paths) {
+            journals.push_back(std::make_unique<MappedJournal>(path));
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    if (list_laps) {
+        try {
+            for (const auto& journal : journals) {
+                print_laps(*journal);
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Error decoding journal: " << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+    if (timeline) {
+        try {
+            print_timeline(journals);
+        } catch (const std::exception& e) {
+            std::cerr << "Error decoding journal: " << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    std::vector<std::pair<std::size_t, std::size_t>> work;
+    for (std::size_t f = 0; f < journals.size(); ++f) {
+        for (std::size_t offset : journals[f]->segments) {
+            work.emplace_back(f, offset);
+        }
+    }
+
+    struct Worker {
+        std::map<std::pair<std::size_t, std::uint64_t>, SourceSummary> summaries;
+        std::vector<std::pair<std::size_t, SegmentEdge>> edges;
+        std::string error;
+    };
+    std::vector<Worker> workers(threads);
+    std::atomic<std::size_t> next{0};
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < threads; ++t) {
+        pool.emplace_back([&, t]() {
+            Worker& self = workers[t];
+            std::vector<JournalRecord> records;
+            std::vector<SampledJournalRecord> sampled;
+            try {
+                for (std::size_t i = next.fetch_add(1); i < work.size(); i = next.fetch_add(1)) {
+                    const MappedJournal& journal = *journals[work[i].first];
+                    JournalSegmentHeader h = journal.header(work[i].second);
+                    if (h.encoding == JOURNAL_ENCODING_CLOCK_MAP) {
+                        continue;
+                    }
+                    if (h.encoding == JOURNAL_ENCODING_SAMPLED) {
+                        journal.decodeSampled(work[i].second, sampled);
+                        if (sampled.empty()) {
+                            continue;
+                        }
+                        SourceSummary& summary = self.summaries[{work[i].first, h.source}];
+                        for (const SampledJournalRecord& r : sampled) {
+                            summary.splits.record(r.split_ns, r.weight);
+                            summary.histogram.record(r.split_ns, r.weight);
+                        }
+                        summary.last_elapsed = std::max(summary.last_elapsed, sampled.back().elapsed_ns);
+                        self.edges.push_back({i, {work[i].first, h.source, sampled.back().lap, 1,
+                                                  sampled.back().elapsed_ns, sampled.back().elapsed_ns, true}});
+                        continue;
+                    }
+                    journal.decode(work[i].second, records);
+                    if (records.empty()) {
+                        continue;
+                    }
+                    SourceSummary& summary = self.summaries[{work[i].first, h.source}];
+                    for (std::size_t r = 1; r < records.size(); ++r) {
+                        std::int64_t split = records[r].elapsed_ns - records[r - 1].elapsed_ns;
+                        summary.splits.record(split);
+                        summary.histogram.record(split);
+                    }
+                    summary.last_elapsed = std::max(summary.last_elapsed, records.back().elapsed_ns);
+                    self.edges.push_back({i, {work[i].first, h.source, h.first_lap, h.count,
+                                              records.front().elapsed_ns, records.back().elapsed_ns, false}});
+                }
+            } catch (const std::exception& e) {
+                self.error = e.what();
+            }
+        });
+    }
+    for (auto& t : pool) {
+        t.join();
+    }
+
+    std::map<std::pair<std::size_t, std::uint64_t>, SourceSummary> totals;
+    std::vector<std::pair<std::size_t, SegmentEdge>> edges;
+    for (Worker& w : workers) {
+        if (!w.error.empty()) {
+            std::cerr << "Error decoding journal: " << w.error << std::endl;
+            return 1;
+        }
+        for (auto& entry : w.summaries) {
+            totals[entry.first].merge(entry.second);
+        }
+        edges.insert(edges.end(), w.edges.begin(), w.edges.end());
+    }
+
+    // Stitch the first split of every segment onto the end of the previous
+    // segment of the same source; lap 1 is measured from zero.
+    std::sort(edges.begin(), edges.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    std::map<std::pair<std::size_t, std::uint64_t>, const SegmentEdge*> previous;
+    for (const auto& entry : edges) {
+        const SegmentEdge& e = entry.second;
+        auto key = std::make_pair(e.file, e.source);
+        SourceSummary& summary = totals[key];
+        auto it = previous.find(key);
+        if (e.sampled) {
+            previous[key] = &e;
+            continue;
+        }
+        std::int64_t split = -1;
+        if (e.first_lap == 1) {
+            split = e.first_elapsed;
+        } else if (it != previous.end() && it->second->first_lap + it->second->count == e.first_lap) {
+            split = e.first_elapsed - it->second->last_elapsed;
+        }
+        if (split >= 0) {
+            summary.splits.record(split);
+            summary.histogram.record(split);
+        }
+        previous[key] = &e;
+    }
+
+    // The newest clock map of each source; maps are rare, so this is a walk
+    // over headers.
+    std::map<std::pair<std::size_t, std::uint64_t>, JournalClockMap> last_maps;
+    for (std::size_t f = 0; f < journals.size(); ++f) {
+        for (std::size_t offset : journals[f]->segments) {
+            JournalSegmentHeader h = journals[f]->header(offset);
+            if (h.encoding == JOURNAL_ENCODING_CLOCK_MAP && h.payload_bytes == sizeof(JournalClockMap)) {
+                last_maps[{f, h.source}] = journals[f]->clockMap(offset);
+            }
+        }
+    }
+
+    std::uint64_t total_laps = 0;
+    for (const auto& entry : totals) {
+        const SourceSummary& s = entry.second;
+        total_laps += s.splits.count;
+        std::cout << label_for(*journals[entry.first.first], entry.first.second) << std::endl;
+        std::cout << "  Laps: " << s.splits.count;
+        if (s.splits.samples != s.splits.count) {
+            std::cout << " (estimated from " << s.splits.samples << " sampled)";
+        }
+        std::cout << std::endl;
+        std::cout << "  Total elapsed: " << format_duration(static_cast<double>(s.last_elapsed)) << std::endl;
+        auto map = last_maps.find(entry.first);
+        if (map != last_maps.end()) {
+            print_clock_map(map->second);
+        }
+        if (s.splits.count == 0) {
+            continue;
+        }
+        std::cout << "  Lap time: mean " << format_duration(s.splits.mean())
+                  << ", stddev " << format_duration(s.splits.stddev())
+                  << ", min " << format_duration(static_cast<double>(s.splits.min))
+                  << ", max " << format_duration(static_cast<double>(s.splits.max)) << std::endl;
+        // Bucket midpoints can overshoot the observed range; report within it.
+        auto percentile = [&s](double q) {
+            auto v = static_cast<std::int64_t>(s.histogram.percentile(q));
+            return format_duration(static_cast<double>(std::clamp(v, s.splits.min, s.splits.max)));
+        };
+        std::cout << "  Percentiles: p50 " << percentile(0.50) << ", p90 " << percentile(0.90)
+                  << ", p99 " << percentile(0.99) << ", p99.9 " << percentile(0.999) << std::endl;
+        if (show_histogram) {
+            print_histogram(s.histogram);
+        }
+    }
+    std::cout << "Total laps: " << total_laps << " in " << work.size() << " segments from " << journals.size() << " journal(s)." << std::endl;
+    return 0;
+}
@@ -0,0 +1,889 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "async_log.h"
+#include "bench_runner.h"
+#include "clock_sync.h"
+#include "frame_pacer.h"
+#include "lap_codec.h"
+#include "lap_events.h"
+#include "lap_journal.h"
+#include "lap_sampler.h"
+#include "lap_stats.h"
+#include "metrics_collector.h"
+#include "metrics_reporter.h"
+#include "status_display.h"
+#include "stopwatch_clock.h"
+#include "stopwatch_state.h"
+#include "time_format.h"
+#include "timer_pool.h"
+#include "timer_table.h"
+
+void add_lap_event_benchmarks(BenchRunner& runner) {
+    const std::size_t events = 1000000;
+
+    // Sustained publish rate from several producers into one consumer, with
+    // the ring sized so that the consumer has to keep up rather than absorb
+    // the whole run in its buffer.
+    for (unsigned producers : {1u, 4u}) {
+        runner.add("lap_events/publish_" + std::to_string(producers) + "p", [producers, events]() {
+            LapEventBus bus(8192, BackpressurePolicy::Wait);
+            bus.subscribe([](const LapEvent*, std::size_t) {});
+            std::vector<std::thread> threads;
+            for (unsigned p = 0; p < producers; ++p) {
+                threads.emplace_back([&bus, p, producers, events]() {
+                    for (std::size_t i = 0; i < events / producers; ++i) {
+                        bus.publish({p, i, std::chrono::nanoseconds(i), 0});
+                    }
+                });
+            }
+            for (auto& t : threads) {
+                t.join();
+            }
+        }, 5, true, events);
+    }
+
+    runner.add("lap_events/publish_drop", [events]() {
+        LapEventBus bus(1024, BackpressurePolicy::Drop);
+        bus.subscribe([](const LapEvent*, std::size_t) {});
+        for (std::size_t i = 0; i < events; ++i) {
+            bus.publish({0, i, std::chrono::nanoseconds(i), 0});
+        }
+    }, 5, true, events);
+}
+
+void add_async_log_benchmarks(BenchRunner& runner) {
+    const std::size_t records = 1000000;
+
+    // Caller-side cost only: the writer thread formats and writes to
+    // /dev/null in the background.
+    auto log = std::make_shared<AsyncLog>(::open("/dev/null", O_WRONLY | O_CLOEXEC), records);
+    runner.add("async_log/log_call", [log, records]() {
+        for (std::size_t i = 0; i < records; ++i) {
+            log->log(LogEvent::Lap, 0, static_cast<double>(i) * 1e-3, static_cast<std::uint32_t>(i));
+        }
+    }, 5, true, records);
+
+    // Baseline: format and write each message on the calling thread.
+    runner.add("async_log/sync_format_write", [records]() {
+        int fd = ::open("/dev/null", O_WRONLY | O_CLOEXEC);
+        std::string line;
+        for (std::size_t i = 0; i < records; ++i) {
+            line.clear();
+            format_log_record({static_cast<double>(i) * 1e-3, 0, static_cast<std::uint32_t>(i), LogEvent::Lap}, line);
+            line += '\n';
+            if (::write(fd, line.data(), line.size()) < 0) {
+                break;
+            }
+        }
+        ::close(fd);
+    }, 5, true, records);
+}
+
+void add_journal_benchmarks(BenchRunner& runner) {
+    const std::size_t laps_per_flush = 16384;
+
+    // One iteration appends a batch of laps and flushes it durably; max gives
+    // the tail of flush latency across iterations.
+    for (JournalBackendKind kind : {JournalBackendKind::IoUring, JournalBackendKind::Pwrite}) {
+        std::string path = "/tmp/stopwatch_bench_" + std::to_string(static_cast<int>(kind)) + ".journal";
+        ::unlink(path.c_str());
+        std::shared_ptr<LapJournal> journal;
+        try {
+            journal = std::make_shared<LapJournal>(path, 0, kind);
+        } catch (const std::exception& e) {
+            std::cerr << "Skipping journal benchmark: " << e.what() << std::endl;
+            continue;
+        }
+        ::unlink(path.c_str());
+        std::string name = kind == JournalBackendKind::IoUring ? "journal/io_uring_flush" : "journal/pwrite_flush";
+        runner.add(name, [journal, laps_per_flush]() {
+            for (std::size_t i = 0; i < laps_per_flush; ++i) {
+                journal->append({static_cast<std::int64_t>(i), 0, 0});
+            }
+            journal->flush();
+        }, 100, true, laps_per_flush);
+    }
+}
+
+// Laps at a 1 ms cadence with sub-microsecond jitter and occasional core
+// migrations and frequency changes.
+std::vector<JournalRecord> synthetic_lap_trace(std::size_t count) {
+    std::mt19937_64 rng(42);
+    std::vector<JournalRecord> trace(count);
+    std::int64_t t = 0;
+    std::int32_t cpu = 0;
+    std::uint32_t khz = 2400000;
+    for (JournalRecord& r : trace) {
+        t += 1000000 + static_cast<std::int64_t>(rng() % 100);
+        if (rng() % 1000 == 0) cpu = static_cast<std::int32_t>(rng() % 8);
+        if (rng() % 100 == 0) khz = 1200000 + static_cast<std::uint32_t>(rng() % 20) * 100000;
+        r = {t, cpu, khz};
+    }
+    return trace;
+}
+
+// Laps taken from real clock reads around a fixed amount of work.
+std::vector<JournalRecord> clock_lap_trace(std::size_t count) {
+    std::vector<JournalRecord> trace(count);
+    auto start = std::chrono::steady_clock::now();
+    volatile std::uint64_t sink = 0;
+    for (JournalRecord& r : trace) {
+        for (int i = 0; i < 200; ++i) {
+            sink = sink + static_cast<std::uint64_t>(i);
+        }
+        r = {std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(), current_cpu(), 0};
+    }
+    return trace;
+}
+
+void add_codec_benchmarks(BenchRunner& runner) {
+    const std::size_t count = 1 << 20;
+    std::vector<std::pair<std::string, std::vector<JournalRecord>>> traces;
+    traces.emplace_back("synthetic", synthetic_lap_trace(count));
+    traces.emplace_back("clock", clock_lap_trace(count));
+
+    for (auto& [name, records] : traces) {
+        auto trace = std::make_shared<std::vector<JournalRecord>>(std::move(records));
+        auto encoded = std::make_shared<std::vector<std::uint8_t>>(lap_codec_max_encoded_size(count));
+        std::size_t bytes = encode_laps(trace->data(), count, encoded->data());
+        std::cout << "codec/" << name << ": " << std::fixed << std::setprecision(2)
+                  << static_cast<double>(count * sizeof(JournalRecord)) / static_cast<double>(bytes)
+                  << "x compression (" << static_cast<double>(bytes) * 8.0 / count << " bits/lap)" << std::endl;
+
+        auto scratch = std::make_shared<std::vector<std::uint8_t>>(encoded->size());
+        runner.add("codec/encode_" + name, [trace, scratch, count]() {
+            encode_laps(trace->data(), count, scratch->data());
+        }, 20, false, count);
+
+        auto decoded = std::make_shared<std::vector<JournalRecord>>(count);
+        runner.add("codec/decode_" + name, [encoded, decoded, bytes, count]() {
+            decode_laps(encoded->data(), bytes, count, decoded->data());
+        }, 20, false, count);
+    }
+}
+
+void add_time_format_benchmarks(BenchRunner& runner) {
+    const std::size_t count = 10000000;
+
+    // Durations spread over every range the formats have to handle, from a
+    // few nanoseconds to days.
+    auto durations = std::make_shared<std::vector<std::int64_t>>(4096);
+    std::mt19937_64 rng(7);
+    for (std::int64_t& d : *durations) {
+        d = static_cast<std::int64_t>(rng() >> (rng() % 64));
+        d %= 400000000000000ll;
+    }
+
+    for (TimeFormat format : {TimeFormat::MinutesSeconds, TimeFormat::HoursMillis, TimeFormat::DaysHours,
+                              TimeFormat::Micros, TimeFormat::Nanos, TimeFormat::Auto}) {
+        runner.add(std::string("time_format/") + to_string(format), [durations, format, count]() {
+            char buf[TIME_FORMAT_MAX_CHARS];
+            std::size_t total = 0;
+            const std::size_t mask = durations->size() - 1;
+            for (std::size_t i = 0; i < count; ++i) {
+                total += static_cast<std::size_t>(format_duration(buf, (*durations)[i & mask], format) - buf);
+            }
+            volatile std::size_t sink = total;
+            (void)sink;
+        }, 5, false, count);
+    }
+
+    // The iostream formatting displayFormattedTime() used before.
+    runner.add("time_format/iostream_mm:ss", [durations]() {
+        std::ostringstream out;
+        for (std::size_t i = 0; i < 100000; ++i) {
+            double seconds = static_cast<double>((*durations)[i & (durations->size() - 1)]) * 1e-9;
+            out.str(std::string());
+            out << std::setfill('0') << std::setw(2) << static_cast<long long>(seconds) / 60 << ":"
+                << std::setfill('0') << std::setw(5) << std::fixed << std::setprecision(2) << std::fmod(seconds, 60.0);
+        }
+    }, 5, false, 100000);
+}
+
+void add_progress_benchmarks(BenchRunner& runner) {
+    const std::size_t frames = 1000000;
+
+    // Frames 4 ms apart against a one-hour target: the cached bar only
+    // rebuilds from the fill edge, the fresh one redraws every cell.
+    for (ProgressStyle style : {ProgressStyle::Ascii, ProgressStyle::Blocks}) {
+        runner.add(std::string("progress/cached_") + to_string(style), [style, frames]() {
+            ProgressBar bar;
+            bar.configure(style, 3600000000000ll, 0);
+            std::string out;
+            for (std::size_t i = 0; i < frames; ++i) {
+                out.clear();
+                bar.render(out, static_cast<std::int64_t>(i) * 4000000, TimeFormat::HoursMillis);
+            }
+        }, 5, false, frames);
+
+        runner.add(std::string("progress/fresh_") + to_string(style), [style, frames]() {
+            std::string out;
+            for (std::size_t i = 0; i < frames; ++i) {
+                ProgressBar bar;
+                bar.configure(style, 3600000000000ll, 0);
+                out.clear();
+                bar.render(out, static_cast<std::int64_t>(i) * 4000000, TimeFormat::HoursMillis);
+            }
+        }, 5, false, frames);
+    }
+}
+
+// Models of the Stopwatch member layout for the contention benchmark: the
+// fields a controlling thread writes on every state change, the settings the
+// display thread reads every tick and the display thread's own flags.
+struct PackedTimerState {
+    std::atomic<std::int64_t> start_ns{0};
+    std::atomic<std::int64_t> elapsed_ns{0};
+    std::atomic<std::uint64_t> laps{0};
+    std::atomic<bool> running{false};
+    std::atomic<bool> paused{false};
+    std::atomic<bool> display_running{true};
+    std::atomic<std::int64_t> interval_ns{1000000};
+    std::atomic<int> format{0};
+};
+
+struct GroupedTimerState {
+    alignas(64) std::atomic<std::int64_t> start_ns{0};
+    std::atomic<std::int64_t> elapsed_ns{0};
+    std::atomic<std::uint64_t> laps{0};
+    std::atomic<bool> running{false};
+    std::atomic<bool> paused{false};
+    alignas(64) std::atomic<std::int64_t> interval_ns{1000000};
+    std::atomic<int> format{0};
+    alignas(64) std::atomic<bool> display_running{true};
+};
+
+// perf-c2c-style workload over an array of timers: writer threads drive
+// start/lap/stop on their own timers while a display thread keeps sweeping
+// the settings and display flags of every timer. With the packed layout the
+// writes land on lines the display thread (and neighbouring timers) read.
+template <typename State>
+void run_layout_contention(std::size_t timers, unsigned writers, std::size_t rounds) {
+    std::vector<State> states(timers);
+    std::atomic<unsigned> active{writers};
+    std::vector<std::thread> threads;
+    for (unsigned w = 0; w < writers; ++w) {
+        threads.emplace_back([&states, &active, w, writers, rounds]() {
+            for (std::size_t r = 0; r < rounds; ++r) {
+                for (std::size_t i = w; i < states.size(); i += writers) {
+                    State& s = states[i];
+                    s.start_ns.store(static_cast<std::int64_t>(r), std::memory_order_relaxed);
+                    s.running.store(true, std::memory_order_release);
+                    s.laps.fetch_add(1, std::memory_order_relaxed);
+                    s.elapsed_ns.fetch_add(1, std::memory_order_relaxed);
+                    s.running.store(false, std::memory_order_release);
+                }
+            }
+            active.fetch_sub(1, std::memory_order_release);
+        });
+    }
+    std::int64_t sink = 0;
+    while (active.load(std::memory_order_acquire) > 0) {
+        for (State& s : states) {
+            if (s.display_running.load(std::memory_order_relaxed)) {
+                sink += s.interval_ns.load(std::memory_order_relaxed) + s.format.load(std::memory_order_relaxed);
+            }
+        }
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    volatile std::int64_t keep = sink;
+    (void)keep;
+}
+
+void add_layout_benchmarks(BenchRunner& runner) {
+    const std::size_t timers = 64;
+    const std::size_t rounds = 20000;
+    unsigned writers = std::max(2u, std::thread::hardware_concurrency() - 1);
+    std::cout << "layout: packed timer " << sizeof(PackedTimerState) << " bytes, grouped timer "
+              << sizeof(GroupedTimerState) << " bytes, " << writers << " writers" << std::endl;
+    runner.add("layout/packed_contention", [timers, writers, rounds]() {
+        run_layout_contention<PackedTimerState>(timers, writers, rounds);
+    }, 5, true, timers * rounds);
+    runner.add("layout/grouped_contention", [timers, writers, rounds]() {
+        run_layout_contention<GroupedTimerState>(timers, writers, rounds);
+    }, 5, true, timers * rounds);
+}
+
+void add_timer_table_benchmarks(BenchRunner& runner) {
+    const std::size_t timers = 1 << 20;
+    std::cout << "timer_table: " << TimerTable::BYTES_PER_TIMER << " bytes per timer" << std::endl;
+
+    // Half the timers running, spread across the table.
+    auto table = std::make_shared<TimerTable>(timers);
+    for (std::size_t i = 0; i < timers; i += 2) {
+        table->start(i, 0);
+    }
+    auto out = std::make_shared<std::vector<std::int64_t>>(timers);
+    runner.add("timer_table/elapsed_all", [table, out]() {
+        table->elapsedAll(1000000, out->data());
+    }, 50, false, timers);
+    runner.add("timer_table/total_elapsed", [table]() {
+        volatile std::int64_t total = table->totalElapsed(1000000);
+        (void)total;
+    }, 50, false, timers);
+    auto batch = std::make_shared<TimerTable>(timers);
+    runner.add("timer_table/start_pause_range", [batch, timers]() {
+        batch->startRange(0, timers, 10);
+        batch->pauseRange(0, timers, 20);
+    }, 50, false, timers);
+
+    auto indices = std::make_shared<std::vector<std::uint32_t>>(timers);
+    std::mt19937 rng(3);
+    for (std::uint32_t& i : *indices) {
+        i = static_cast<std::uint32_t>(rng() % timers);
+    }
+    auto scattered = std::make_shared<TimerTable>(timers);
+    runner.add("timer_table/start_pause_many", [scattered, indices]() {
+        scattered->startMany(indices->data(), indices->size(), 10);
+        scattered->pauseMany(indices->data(), indices->size(), 20);
+    }, 20, false, timers);
+
+    // Baseline: the same elapsed sweep over per-timer atomic state words.
+    auto states = std::make_shared<std::vector<AtomicStopwatchState>>(timers);
+    for (std::size_t i = 0; i < timers; i += 2) {
+        (*states)[i].start();
+    }
+    runner.add("timer_table/atomic_state_elapsed_all", [states, out]() {
+        auto now = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < states->size(); ++i) {
+            (*out)[i] = (*states)[i].elapsedNs(now);
+        }
+    }, 50, false, timers);
+}
+
+// Per-lap cost of recording every lap into statistics versus sampling: the
+// sampled path only reads the clock at the ends of an armed interval, the way
+// Stopwatch::lap() does.
+void add_sampling_benchmarks(BenchRunner& runner) {
+    const std::size_t laps = 1000000;
+    runner.add("sampling/every_lap", [laps]() {
+        LapStats stats;
+        LapHistogram histogram;
+        std::int64_t previous = 0;
+        for (std::size_t i = 0; i < laps; ++i) {
+            std::int64_t now = std::chrono::steady_clock::now().time_since_epoch().count();
+            stats.record(now - previous);
+            histogram.record(now - previous);
+            previous = now;
+        }
+        volatile double keep = stats.mean();
+        (void)keep;
+    }, 10, false, laps);
+
+    for (std::uint32_t rate : {16u, 256u, 0u}) {
+        std::string name = rate ? "sampling/1_in_" + std::to_string(rate) : std::string("sampling/budget_1pct");
+        // The budgeted sampler persists across runs, as it would across a
+        // long-lived stopwatch's laps, so later runs see the adapted rate.
+        auto shared = std::make_shared<LapSampler>(rate ? rate : 1, 7);
+        if (rate == 0) {
+            shared->setBudget(0.01);
+        }
+        runner.add(name, [laps, shared]() {
+            LapSampler& sampler = *shared;
+            LapStats stats;
+            LapHistogram histogram;
+            bool armed = false;
+            std::int64_t start = 0;
+            std::uint32_t weight = 1;
+            for (std::size_t i = 0; i < laps; ++i) {
+                if (armed) {
+                    std::int64_t now = std::chrono::steady_clock::now().time_since_epoch().count();
+                    stats.record(now - start, weight);
+                    histogram.record(now - start, weight);
+                    armed = false;
+                    std::int64_t done = std::chrono::steady_clock::now().time_since_epoch().count();
+                    sampler.recorded(done - now, done);
+                    if (sampler.sample()) {
+                        armed = true;
+                        start = now;
+                        weight = sampler.weight();
+                    }
+                } else if (sampler.sample()) {
+                    armed = true;
+                    start = std::chrono::steady_clock::now().time_since_epoch().count();
+                    weight = sampler.weight();
+                }
+            }
+            volatile double keep = stats.mean();
+            (void)keep;
+        }, 10, false, laps);
+    }
+}
+
+void add_clock_benchmarks(BenchRunner& runner) {
+    const std::size_t reads = 1000000;
+    for (ClockSource source : {ClockSource::Steady, ClockSource::Coarse, ClockSource::Cached}) {
+        // Resolution as seen by a reader: the mean step between distinct
+        // readings, and how far a reading trails steady_clock.
+        auto clock = std::make_shared<StopwatchClock>(source);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        std::int64_t steps = 0;
+        double step_sum = 0.0;
+        double lag_sum = 0.0;
+        auto last = clock->now();
+        auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(50);
+        std::size_t samples = 0;
+        while (std::chrono::steady_clock::now() < until) {
+            auto t = clock->now();
+            lag_sum += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t).count();
+            ++samples;
+            if (t != last) {
+                step_sum += std::chrono::duration<double, std::micro>(t - last).count();
+                ++steps;
+                last = t;
+            }
+        }
+        std::cout << "clock/" << to_string(source) << ": resolution "
+                  << std::chrono::duration<double, std::micro>(StopwatchClock::resolution(source)).count()
+                  << " us, observed step " << (steps > 0 ? step_sum / static_cast<double>(steps) : 0.0)
+                  << " us, mean lag " << lag_sum / static_cast<double>(samples) << " us" << std::endl;
+
+        runner.add(std::string("clock/") + to_string(source) + "_now", [clock, reads]() {
+            std::int64_t sink = 0;
+            for (std::size_t i = 0; i < reads; ++i) {
+                sink += clock->now().time_since_epoch().count();
+            }
+            volatile std::int64_t keep = sink;
+            (void)keep;
+        }, 10, true, reads);
+    }
+
+    // Full-resolution reads in the other domains, which have no vDSO-cached
+    // coarse variant.
+    for (ClockDomain domain : {ClockDomain::Boottime, ClockDomain::MonotonicRaw}) {
+        auto clock = std::make_shared<StopwatchClock>(ClockSource::Steady, domain);
+        runner.add(std::string("clock/") + to_string(domain) + "_now", [clock, reads]() {
+            std::int64_t sink = 0;
+            for (std::size_t i = 0; i < reads; ++i) {
+                sink += clock->now().time_since_epoch().count();
+            }
+            volatile std::int64_t keep = sink;
+            (void)keep;
+        }, 10, true, reads);
+    }
+}
+
+void add_timer_pool_benchmarks(BenchRunner& runner) {
+    const std::size_t cycles = 200000;
+    unsigned threads = std::max(2u, std::thread::hardware_concurrency());
+
+    // One request's worth of timing: acquire, start, stop, release. The clock
+    // is read once up front so the figures are the bookkeeping alone.
+    auto now = std::chrono::steady_clock::now();
+    auto pool = std::make_shared<TimerPool>(1024);
+    runner.add("timer_pool/acquire_release", [pool, cycles, now]() {
+        for (std::size_t i = 0; i < cycles; ++i) {
+            TimerHandle h;
+            pool->acquire(h);
+            pool->get(h)->start(now);
+            pool->get(h)->stop(now);
+            pool->release(h);
+        }
+    }, 10, false, cycles);
+    runner.add("timer_pool/acquire_release_contended", [pool, cycles, threads, now]() {
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < threads; ++t) {
+            workers.emplace_back([pool, cycles, threads, now]() {
+                for (std::size_t i = 0; i < cycles / threads; ++i) {
+                    TimerHandle h;
+                    if (pool->acquire(h)) {
+                        pool->get(h)->start(now);
+                        pool->get(h)->stop(now);
+                        pool->release(h);
+                    }
+                }
+            });
+        }
+        for (auto& w : workers) {
+            w.join();
+        }
+    }, 10, true, cycles);
+
+    // Baseline: what a per-request Stopwatch costs before its display thread,
+    // the state plus a mutex and a lap vector on the heap.
+    struct HeapTimer {
+        explicit HeapTimer(std::chrono::steady_clock::time_point created) : state(created) {}
+        AtomicStopwatchState state;
+        std::mutex mtx;
+        std::vector<double> laps;
+    };
+    runner.add("timer_pool/heap_baseline", [cycles, now]() {
+        for (std::size_t i = 0; i < cycles; ++i) {
+            auto timer = std::make_unique<HeapTimer>(now);
+            timer->state.start(now);
+            timer->laps.push_back(static_cast<double>(timer->state.stop(now).elapsed_ns));
+        }
+    }, 10, false, cycles);
+}
+
+// Shape of the collector benchmarks: processes x timers, each timer
+// recording COLLECTOR_LAPS laps per flush, for COLLECTOR_ROUNDS flushes.
+constexpr unsigned COLLECTOR_PROCESSES = 100;
+constexpr unsigned COLLECTOR_TIMERS = 1000;
+constexpr unsigned COLLECTOR_LAPS = 20;
+constexpr unsigned COLLECTOR_ROUNDS = 3;
+
+std::string collector_timer_name(unsigned timer) {
+    return "worker/timer_" + std::to_string(timer);
+}
+
+// Lap times spread over a few hundred microseconds, so each timer's delta
+// has a realistic number of distinct buckets.
+std::int64_t collector_lap_ns(unsigned timer, unsigned lap) {
+    return 50000 + static_cast<std::int64_t>((timer * 7919u + lap * 104729u) % 400000u);
+}
+
+// Body of one reporting process, run as `stopwatch_bench --collector-worker
+// SOCKET`: flushes are driven by hand rather than by the interval.
+int run_collector_worker(const std::string& socket_path) {
+    MetricsReporter reporter(socket_path, std::chrono::hours(1));
+    std::vector<std::size_t> timers;
+    for (unsigned t = 0; t < COLLECTOR_TIMERS; ++t) {
+        timers.push_back(reporter.timer(collector_timer_name(t)));
+    }
+    for (unsigned round = 0; round < COLLECTOR_ROUNDS; ++round) {
+        for (unsigned lap = 0; lap < COLLECTOR_LAPS; ++lap) {
+            for (unsigned t = 0; t < COLLECTOR_TIMERS; ++t) {
+                reporter.record(timers[t], collector_lap_ns(t, lap));
+            }
+        }
+        reporter.flush();
+    }
+    // Whatever the collector was too busy to take goes with later flushes.
+    for (int retry = 0; retry < 50 && !reporter.flush(); ++retry) {
+    }
+    return reporter.flush() ? 0 : 1;
+}
+
+void add_collector_benchmarks(BenchRunner& runner) {
+    const std::size_t deltas = std::size_t(COLLECTOR_PROCESSES) * COLLECTOR_TIMERS;
+
+    // Merge cost alone: one flush from every process, encoded up front.
+    auto datagrams = std::make_shared<std::vector<std::string>>();
+    {
+        std::string datagram;
+        TimerDelta delta;
+        for (unsigned p = 0; p < COLLECTOR_PROCESSES; ++p) {
+            for (unsigned t = 0; t < COLLECTOR_TIMERS; ++t) {
+                delta.key = metrics_key(collector_timer_name(t));
+                delta.stats = LapStats();
+                LapHistogram histogram;
+                for (unsigned lap = 0; lap < COLLECTOR_LAPS; ++lap) {
+                    delta.stats.record(collector_lap_ns(t, lap));
+                    histogram.record(collector_lap_ns(t, lap));
+                }
+                delta.buckets.clear();
+                for (unsigned b = 0; b < LapHistogram::BUCKETS; ++b) {
+                    if (histogram.bucketCount(b)) {
+                        delta.buckets.emplace_back(b, histogram.bucketCount(b));
+                    }
+                }
+                std::string entry;
+                encode_timer_delta(entry, delta);
+                if (datagram.size() + entry.size() > METRICS_MAX_DATAGRAM) {
+                    datagrams->push_back(datagram);
+                    datagram.clear();
+                }
+                if (datagram.empty()) {
+                    put_metrics_header(datagram, MetricsMessage::Delta, 0, p + 1, static_cast<std::uint32_t>(datagrams->size()));
+                }
+                datagram += entry;
+            }
+            datagrams->push_back(datagram);
+            datagram.clear();
+        }
+    }
+    auto collector = std::make_shared<MetricsCollector>();
+    runner.add("collector/ingest_100x1000", [datagrams, collector]() {
+        for (const std::string& d : *datagrams) {
+            collector->ingest(d.data(), d.size());
+        }
+    }, 10, false, deltas);
+    runner.add("collector/report_1000", [collector]() {
+        std::string text;
+        collector->report(text);
+    }, 10, false, COLLECTOR_TIMERS);
+
+    // The real thing: COLLECTOR_PROCESSES reporting processes sending over
+    // the socket to a collector loop on this thread. The time covers
+    // spawning the processes and their recording as well as the collector.
+    runner.add("collector/end_to_end_100p", [deltas]() {
+        std::string path = "/tmp/stopwatch-bench-" + std::to_string(::getpid()) + ".sock";
+        int fd = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        std::snprintf(address.sun_path, sizeof(address.sun_path), "%s", path.c_str());
+        ::unlink(path.c_str());
+        if (fd < 0 || ::bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+            std::cerr << "collector/end_to_end_100p: unable to bind " << path << std::endl;
+            return;
+        }
+        int buffer = 8 << 20;
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer));
+        timeval timeout{0, 10000};
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        std::vector<pid_t> children;
+        std::string flag = "--collector-worker";
+        char* args[] = {const_cast<char*>("stopwatch_bench"), flag.data(), path.data(), nullptr};
+        for (unsigned p = 0; p < COLLECTOR_PROCESSES; ++p) {
+            pid_t pid;
+            if (::posix_spawn(&pid, "/proc/self/exe", nullptr, nullptr, args, environ) == 0) {
+                children.push_back(pid);
+            }
+        }
+
+        // Reporters exit only once their last datagram is queued, so the
+        // socket is drained once all of them have been reaped.
+        MetricsCollector collector;
+        std::vector<std::uint8_t> datagram(METRICS_MAX_DATAGRAM);
+        double ingest_seconds = 0.0;
+        std::size_t running = children.size();
+        int failed = 0;
+        while (true) {
+            ssize_t n = ::recv(fd, datagram.data(), datagram.size(), running > 0 ? 0 : MSG_DONTWAIT);
+            if (n > 0) {
+                auto start = std::chrono::steady_clock::now();
+                collector.ingest(datagram.data(), static_cast<std::size_t>(n));
+                ingest_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            } else if (running == 0) {
+                break;
+            }
+            int status;
+            for (pid_t child; running > 0 && (child = ::waitpid(-1, &status, WNOHANG)) > 0;) {
+                --running;
+                failed += !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+            }
+        }
+        ::close(fd);
+        ::unlink(path.c_str());
+
+        const MetricsCollector::Counters& c = collector.counters();
+        const MetricsCollector::Timer* first = collector.find(collector_timer_name(0));
+        bool complete = first && first->stats.count == std::uint64_t(COLLECTOR_PROCESSES) * COLLECTOR_ROUNDS * COLLECTOR_LAPS;
+        std::cout << "collector/end_to_end_100p: " << collector.reporterCount() << " processes, " << c.deltas
+                  << " deltas in " << c.datagrams << " datagrams, " << std::fixed << std::setprecision(1)
+                  << static_cast<double>(c.bytes) / static_cast<double>(std::max<std::uint64_t>(c.deltas, 1))
+                  << " bytes/delta, ingest " << std::setprecision(0)
+                  << static_cast<double>(c.deltas) / std::max(ingest_seconds, 1e-9) << " deltas/s, " << c.lost
+                  << " lost, " << failed << " reporters gave up, totals " << (complete ? "complete" : "INCOMPLETE")
+                  << std::endl;
+    }, 1, true, deltas * COLLECTOR_ROUNDS);
+}
+
+// A reference clock for the clock_sync benchmarks: this host's
+// CLOCK_MONOTONIC moved by a fixed offset and running fast by a skew, as a
+// collector's clock on another host might.
+struct SimulatedReference {
+    std::int64_t base_ns;
+    std::int64_t offset_ns;
+    double skew;
+
+    std::int64_t at(std::int64_t local_ns) const {
+        return local_ns + offset_ns + std::llround(skew * static_cast<double>(local_ns - base_ns));
+    }
+};
+
+void add_clock_sync_benchmarks(BenchRunner& runner) {
+    // The fit alone, on a window of bursts spaced 10 s apart in simulated
+    // time, each leg delayed by 2-20 us of queueing. Prints how far the
+    // mapping lands from the simulated reference.
+    const std::size_t fits = 10000;
+    runner.add("clock_sync/estimate_16", [fits]() {
+        SimulatedReference reference{0, 1500000, 100e-6};
+        std::mt19937_64 rng(42);
+        std::uniform_int_distribution<std::int64_t> delay(2000, 20000);
+        ClockSyncEstimator estimator;
+        for (std::size_t burst = 0; burst < ClockSyncEstimator::WINDOW; ++burst) {
+            ClockSyncSample samples[ClockSync::PINGS];
+            for (unsigned i = 0; i < ClockSync::PINGS; ++i) {
+                ClockSyncSample& s = samples[i];
+                s.t1 = static_cast<std::int64_t>(burst) * 10000000000ll + i * 100000;
+                std::int64_t arrive = s.t1 + delay(rng);
+                std::int64_t leave = arrive + 1000;
+                s.t2 = reference.at(arrive);
+                s.t3 = reference.at(leave);
+                s.t4 = leave + delay(rng);
+            }
+            estimator.addBurst(samples, ClockSync::PINGS);
+        }
+        ClockMapping mapping;
+        for (std::size_t i = 0; i < fits; ++i) {
+            mapping = estimator.estimate(1, ClockDomain::Monotonic);
+        }
+        std::int64_t local = mapping.local_ns + 5000000000ll;
+        std::cout << "clock_sync/estimate_16: offset error "
+                  << std::llabs(mapping.toReference(local) - reference.at(local)) << " ns 5 s past the last burst, skew "
+                  << std::fixed << std::setprecision(3) << mapping.skew * 1e6 << " ppm (true 100), uncertainty "
+                  << mapping.uncertainty_ns << " ns" << std::endl;
+    }, 1, false, fits);
+
+    // Bursts against a reference thread on a Unix socket, answering the way
+    // the collector does but on the simulated clock.
+    const std::size_t bursts = 50;
+    runner.add("clock_sync/burst", [bursts]() {
+        std::string path = "/tmp/stopwatch-bench-sync-" + std::to_string(::getpid()) + ".sock";
+        int fd = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        std::snprintf(address.sun_path, sizeof(address.sun_path), "%s", path.c_str());
+        ::unlink(path.c_str());
+        if (fd < 0 || ::bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+            std::cerr << "clock_sync/burst: unable to bind " << path << std::endl;
+            return;
+        }
+        timeval timeout{0, 10000};
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        SimulatedReference reference{clock_detail::read_ns(CLOCK_MONOTONIC), 1500000, 100e-6};
+        auto now = [&reference]() { return reference.at(clock_detail::read_ns(CLOCK_MONOTONIC)); };
+        std::atomic<bool> done{false};
+        std::thread server([&]() {
+            std::uint8_t request[64];
+            std::string reply;
+            while (!done.load(std::memory_order_relaxed)) {
+                sockaddr_un from;
+                socklen_t from_length = sizeof(from);
+                ssize_t n = ::recvfrom(fd, request, sizeof(request), 0, reinterpret_cast<sockaddr*>(&from), &from_length);
+                std::int64_t received_ns = now();
+                const std::uint8_t* p = request;
+                MetricsHeader header;
+                if (n > 0 && read_metrics_header(p, request + n, header) && header.type == MetricsMessage::SyncRequest &&
+                    clock_sync_answer(header, p, request + n, received_ns, 1, reply, now)) {
+                    ::sendto(fd, reply.data(), reply.size(), MSG_NOSIGNAL, reinterpret_cast<const sockaddr*>(&from),
+                             from_length);
+                }
+            }
+        });
+        {
+            ClockSync sync(path, ClockDomain::Monotonic, std::chrono::hours(1));
+            for (std::size_t i = 1; i < bursts; ++i) {
+                sync.syncNow();
+            }
+            ClockMapping mapping = sync.mapping();
+            std::int64_t local = clock_detail::read_ns(CLOCK_MONOTONIC);
+            std::cout << "clock_sync/burst: offset error " << std::llabs(mapping.toReference(local) - reference.at(local))
+                      << " ns, uncertainty " << mapping.uncertainty_ns << " ns, " << sync.failedCount()
+                      << " failed bursts" << std::endl;
+        }
+        done = true;
+        server.join();
+        ::close(fd);
+        ::unlink(path.c_str());
+    }, 1, true, bursts);
+}
+
+double thread_cpu_seconds() {
+    timespec ts;
+    ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) * 1e-9;
+}
+
+void add_display_benchmarks(BenchRunner& runner) {
+    // Renders and writes status frames to /dev/null at a fixed rate for one
+    // second, paced on absolute deadlines the way the display thread is. Wall
+    // time is fixed by the rate; the figures that matter are the CPU share of
+    // the display thread and how late frames went out.
+    for (int hz : {60, 240}) {
+        const std::size_t frames = static_cast<std::size_t>(hz);
+        runner.add("display/" + std::to_string(hz) + "hz", [hz, frames]() {
+            int fd = ::open("/dev/null", O_WRONLY | O_CLOEXEC);
+            std::string frame;
+            ProgressBar bar;
+            bar.configure(ProgressStyle::Blocks, 60000000000ll, 0);
+            FramePacer pacer(std::chrono::nanoseconds(1000000000 / hz));
+            std::vector<double> lateness;
+            lateness.reserve(frames);
+            double cpu_start = thread_cpu_seconds();
+            auto start = FramePacer::clock::now();
+            for (std::size_t i = 0; i < frames; ++i) {
+                auto now = FramePacer::clock::now();
+                lateness.push_back(std::chrono::duration<double, std::micro>(now - pacer.nextDeadline()).count());
+                render_status(frame, std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count(), StatusState::Running, &bar);
+                if (::write(fd, frame.data(), frame.size()) < 0) {
+                    break;
+                }
+                pacer.frameRendered(FramePacer::clock::now() - now);
+                std::this_thread::sleep_until(pacer.advance(FramePacer::clock::now()));
+            }
+            double cpu = thread_cpu_seconds() - cpu_start;
+            double wall = std::chrono::duration<double>(FramePacer::clock::now() - start).count();
+            ::close(fd);
+            std::sort(lateness.begin(), lateness.end());
+            std::cout << "display/" << hz << "hz: " << std::fixed << std::setprecision(3) << cpu / wall * 100.0
+                      << "% cpu, " << std::setprecision(0) << pacer.frameCostSeconds() * 1e9 << " ns/frame, p99 late "
+                      << lateness[lateness.size() * 99 / 100] << " us, " << pacer.droppedFrames() << " dropped" << std::endl;
+        }, 3, true, frames);
+    }
+}
+
+void print_results(const std::vector<BenchResult>& results) {
+    std::cout << std::left << std::setw(40) << "Benchmark" << std::right
+              << std::setw(14) << "mean (ms)" << std::setw(14) << "min (ms)" << std::setw(14) << "max (ms)"
+              << std::setw(18) << "items/s" << std::setw(6) << "cpu" << std::endl;
+    for (const BenchResult& r : results) {
+        std::cout << std::left << std::setw(40) << r.name << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(14) << r.mean().count() * 1000.0
+                  << std::setw(14) << r.min.count() * 1000.0
+                  << std::setw(14) << r.max.count() * 1000.0
+                  << std::setw(18) << std::setprecision(0) << r.itemsPerSecond()
+                  << std::setw(6) << r.cpu << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc == 3 && std::string(argv[1]) == "--collector-worker") {
+        return run_collector_worker(argv[2]);
+    }
+    unsigned workers = std::thread::hardware_concurrency();
+    std::string filter;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--serial") {
+            workers = 1;
+        } else {
+            filter = arg;
+        }
+    }
+
+    BenchRunner runner;
+    add_lap_event_benchmarks(runner);
+    add_async_log_benchmarks(runner);
+    add_journal_benchmarks(runner);
+    add_codec_benchmarks(runner);
+    add_time_format_benchmarks(runner);
+    add_progress_benchmarks(runner);
+    add_layout_benchmarks(runner);
+    add_timer_table_benchmarks(runner);
+    add_timer_pool_benchmarks(runner);
+    add_clock_benchmarks(runner);
+    add_sampling_benchmarks(runner);
+    add_collector_benchmarks(runner);
+    add_clock_sync_benchmarks(runner);
+    add_display_benchmarks(runner);
+    runner.setFilter(filter);
+
+    print_results(runner.run(workers));
+    return 0;
+}
@@ -0,0 +1,326 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+#include <thread>
+
+#include <time.h>
+
+// How a stopwatch reads the time. All three read the same clock domain (see
+// ClockDomain), so time points from any of them can be mixed; they trade
+// resolution for the cost of a read:
+//   Steady  full steady_clock::now(), nanosecond resolution.
+//   Coarse  CLOCK_MONOTONIC_COARSE: the kernel's last timer tick, read from
+//           the vDSO without touching the TSC. Resolution is one jiffy (1-4 ms
+//           depending on CONFIG_HZ; see StopwatchClock::resolution()).
+//   Cached  process-wide timestamps refreshed every millisecond by a ticker
+//           thread, so a read is a single relaxed load. The thread runs while
+//           any stopwatch uses this source and costs a wakeup (and one read
+//           per domain) per millisecond.
+enum class ClockSource {
+    Steady,
+    Coarse,
+    Cached
+};
+
+// Which clock the time is taken from. steady_clock is CLOCK_MONOTONIC, which
+// stops while the system is suspended, so a stopwatch left running across a
+// suspend under-reports:
+//   Monotonic     CLOCK_MONOTONIC, NTP-slewed, stops during suspend.
+//   Boottime      CLOCK_BOOTTIME, as Monotonic but keeps counting in suspend.
+//   MonotonicRaw  CLOCK_MONOTONIC_RAW, the hardware rate without NTP slewing.
+// There is no coarse variant of the last two; the Coarse source reads them
+// at full resolution.
+enum class ClockDomain {
+    Monotonic,
+    Boottime,
+    MonotonicRaw
+};
+
+constexpr std::size_t CLOCK_DOMAIN_COUNT = 3;
+
+inline const char* to_string(ClockSource source) {
+    switch (source) {
+        case ClockSource::Steady: return "steady";
+        case ClockSource::Coarse: return "coarse";
+        case ClockSource::Cached: return "cached";
+    }
+    return "steady";
+}
+
+inline bool parse_clock_source(std::string_view name, ClockSource& source) {
+    for (ClockSource s : {ClockSource::Steady, ClockSource::Coarse, ClockSource::Cached}) {
+        if (name == to_string(s)) {
+            source = s;
+            return true;
+        }
+    }
+    return false;
+}
+
+inline const char* to_string(ClockDomain domain) {
+    switch (domain) {
+        case ClockDomain::Monotonic: return "monotonic";
+        case ClockDomain::Boottime: return "boottime";
+        case ClockDomain::MonotonicRaw: return "monotonic_raw";
+    }
+    return "monotonic";
+}
+
+inline bool parse_clock_domain(std::string_view name, ClockDomain& domain) {
+    for (ClockDomain d : {ClockDomain::Monotonic, ClockDomain::Boottime, ClockDomain::MonotonicRaw}) {
+        if (name == to_string(d)) {
+            domain = d;
+            return true;
+        }
+    }
+    return false;
+}
+
+namespace clock_detail {
+
+inline std::int64_t read_ns(clockid_t id) {
+    timespec ts;
+    ::clock_gettime(id, &ts);
+    return static_cast<std::int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// Falls back to CLOCK_MONOTONIC where the kernel lacks the domain.
+inline clockid_t clock_id(ClockDomain domain) {
+    switch (domain) {
+        case ClockDomain::Monotonic: break;
+#ifdef CLOCK_BOOTTIME
+        case ClockDomain::Boottime: return CLOCK_BOOTTIME;
+#endif
+#ifdef CLOCK_MONOTONIC_RAW
+        case ClockDomain::MonotonicRaw: return CLOCK_MONOTONIC_RAW;
+#endif
+        default: break;
+    }
+    return CLOCK_MONOTONIC;
+}
+
+}
+
+// The shared timestamps behind ClockSource::Cached, one per domain. Users
+// retain() them while they read them; the ticker thread starts with the first
+// user and stops with the last.
+class CachedClock {
+public:
+    static constexpr std::chrono::milliseconds PERIOD{1};
+
+private:
+    inline static std::atomic<std::int64_t> cached_ns[CLOCK_DOMAIN_COUNT]{};
+    // lifecycle serializes starting and joining the ticker; mtx and cv only
+    // wake it early to stop.
+    inline static std::mutex lifecycle;
+    inline static std::mutex mtx;
+    inline static std::condition_variable cv;
+    inline static std::thread ticker;
+    inline static std::size_t users = 0;
+    inline static bool stopping = false;
+
+    static void refresh() {
+        for (ClockDomain d : {ClockDomain::Monotonic, ClockDomain::Boottime, ClockDomain::MonotonicRaw}) {
+            cached_ns[static_cast<std::size_t>(d)].store(clock_detail::read_ns(clock_detail::clock_id(d)), std::memory_order_relaxed);
+        }
+    }
+
+public:
+    static void retain() {
+        std::lock_guard<std::mutex> guard(lifecycle);
+        if (users++ > 0) {
+            return;
+        }
+        stopping = false;
+        refresh();
+        ticker = std::thread([]() {
+            std::unique_lock<std::mutex> lock(mtx);
+            while (!stopping) {
+                cv.wait_for(lock, PERIOD);
+                refresh();
+            }
+        });
+    }
+
+    static void release() {
+        std::lock_guard<std::mutex> guard(lifecycle);
+        if (users == 0 || --users > 0) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        cv.notify_all();
+        ticker.join();
+    }
+
+    static std::int64_t nowNs(ClockDomain domain) {
+        return cached_ns[static_cast<std::size_t>(domain)].load(std::memory_order_relaxed);
+    }
+};
+
+// Ties a stopwatch clock reading to CLOCK_REALTIME, so exported laps can be
+// given wall-clock times by offset instead of a system_clock read per lap.
+// The mapping drifts as the two clocks are slewed apart (and, in the
+// Monotonic domain, by the length of any suspend), so it is re-taken at
+// every start.
+struct ClockAnchor {
+    std::chrono::steady_clock::time_point clock_time;
+    std::int64_t realtime_ns = 0;
+    // Half the window the realtime read was bracketed in.
+    std::int64_t uncertainty_ns = 0;
+
+    std::int64_t realtimeNs(std::chrono::steady_clock::time_point t) const {
+        return realtime_ns + std::chrono::duration_cast<std::chrono::nanoseconds>(t - clock_time).count();
+    }
+};
+
+// The clock a Stopwatch reads on start/stop/lap. Source, domain and the
+// domain's offset share one atomic word, so now() may run concurrently with
+// the setters and always sees a consistent combination. The setters and
+// anchor() are serialized by the owner.
+//
+// Readings stay on the steady_clock timeline the stopwatch was created on: a
+// new domain is offset to continue from the current reading, and from then
+// on advances at that domain's rate (for Boottime, through suspends).
+class StopwatchClock {
+public:
+    using clock = std::chrono::steady_clock;
+    using time_point = clock::time_point;
+
+private:
+    // Bits 0-1: source. Bits 2-3: domain. Bits 4-63: signed offset in ns
+    // subtracted from the domain's raw reading.
+    std::atomic<std::uint64_t> mode{0};
+    ClockAnchor recorded;
+
+    static std::uint64_t pack(ClockSource source, ClockDomain domain, std::int64_t offset) {
+        return static_cast<std::uint64_t>(source) | static_cast<std::uint64_t>(domain) << 2 |
+               static_cast<std::uint64_t>(offset) << 4;
+    }
+
+    static ClockSource source_of(std::uint64_t m) { return static_cast<ClockSource>(m & 3); }
+    static ClockDomain domain_of(std::uint64_t m) { return static_cast<ClockDomain>(m >> 2 & 3); }
+    static std::int64_t offset_of(std::uint64_t m) { return static_cast<std::int64_t>(m) >> 4; }
+
+    static std::int64_t raw_ns(ClockSource source, ClockDomain domain) {
+        switch (source) {
+            case ClockSource::Steady:
+                break;
+            case ClockSource::Coarse:
+#ifdef CLOCK_MONOTONIC_COARSE
+                if (domain == ClockDomain::Monotonic) {
+                    return clock_detail::read_ns(CLOCK_MONOTONIC_COARSE);
+                }
+#endif
+                break;
+            case ClockSource::Cached:
+                return CachedClock::nowNs(domain);
+        }
+        if (domain == ClockDomain::Monotonic) {
+            return clock::now().time_since_epoch().count();
+        }
+        return clock_detail::read_ns(clock_detail::clock_id(domain));
+    }
+
+    static time_point read(std::uint64_t m) {
+        return time_point(std::chrono::nanoseconds(raw_ns(source_of(m), domain_of(m)) - offset_of(m)));
+    }
+
+public:
+    explicit StopwatchClock(ClockSource source = ClockSource::Steady, ClockDomain domain = ClockDomain::Monotonic) {
+        setSource(source);
+        setDomain(domain);
+        reanchor();
+    }
+
+    ~StopwatchClock() { setSource(ClockSource::Steady); }
+
+    StopwatchClock(const StopwatchClock&) = delete;
+    StopwatchClock& operator=(const StopwatchClock&) = delete;
+
+    ClockSource source() const { return source_of(mode.load(std::memory_order_relaxed)); }
+    ClockDomain domain() const { return domain_of(mode.load(std::memory_order_relaxed)); }
+
+    void setSource(ClockSource source) {
+        std::uint64_t m = mode.load(std::memory_order_relaxed);
+        ClockSource previous = source_of(m);
+        if (source == previous) {
+            return;
+        }
+        if (source == ClockSource::Cached) {
+            CachedClock::retain();
+        }
+        mode.store(pack(source, domain_of(m), offset_of(m)), std::memory_order_relaxed);
+        if (previous == ClockSource::Cached) {
+            CachedClock::release();
+        }
+    }
+
+    // Re-anchors, since the old anchor described the previous domain's rate.
+    void setDomain(ClockDomain domain) {
+        std::uint64_t m = mode.load(std::memory_order_relaxed);
+        if (domain == domain_of(m)) {
+            return;
+        }
+        std::int64_t current = read(m).time_since_epoch().count();
+        std::int64_t offset = raw_ns(source_of(m), domain) - current;
+        mode.store(pack(source_of(m), domain, offset), std::memory_order_relaxed);
+        reanchor();
+    }
+
+    time_point now() const { return read(mode.load(std::memory_order_relaxed)); }
+
+    // The domain's own clock_gettime() value for a reading from now(), which
+    // other processes on the host can compare against their own.
+    std::int64_t domainNs(time_point t) const {
+        return t.time_since_epoch().count() + offset_of(mode.load(std::memory_order_relaxed));
+    }
+
+    // Takes a fresh anchor: the realtime read with the tightest bracket of
+    // clock reads out of a few tries, placed at the bracket's midpoint.
+    void reanchor() {
+        std::uint64_t m = mode.load(std::memory_order_relaxed);
+        for (int attempt = 0; attempt < 3; ++attempt) {
+            std::int64_t before = raw_ns(ClockSource::Steady, domain_of(m));
+            std::int64_t realtime = clock_detail::read_ns(CLOCK_REALTIME);
+            std::int64_t after = raw_ns(ClockSource::Steady, domain_of(m));
+            std::int64_t half = (after - before) / 2;
+            if (attempt == 0 || half < recorded.uncertainty_ns) {
+                recorded.clock_time = time_point(std::chrono::nanoseconds(before + half - offset_of(m)));
+                recorded.realtime_ns = realtime;
+                recorded.uncertainty_ns = half;
+            }
+        }
+    }
+
+    const ClockAnchor& anchor() const { return recorded; }
+
+    // Smallest step between two distinct readings.
+    static std::chrono::nanoseconds resolution(ClockSource source, ClockDomain domain = ClockDomain::Monotonic) {
+        switch (source) {
+            case ClockSource::Steady:
+                break;
+            case ClockSource::Coarse: {
+#ifdef CLOCK_MONOTONIC_COARSE
+                timespec ts;
+                if (domain == ClockDomain::Monotonic && ::clock_getres(CLOCK_MONOTONIC_COARSE, &ts) == 0) {
+                    return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+                }
+#endif
+                break;
+            }
+            case ClockSource::Cached:
+                return CachedClock::PERIOD;
+        }
+        (void)domain;
+        return std::chrono::nanoseconds(1);
+    }
+};
@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "clock_sync.h"
+#include "metrics_collector.h"
+#include "metrics_wire.h"
+
+// Local collector for MetricsReporter deltas. Runs as a daemon on the socket
+// and prints the aggregated table every --print-interval seconds; with
+// --query it instead asks a running collector for its table and prints that.
+// The daemon also answers ClockSync pings with its CLOCK_MONOTONIC, making it
+// the reference clock that journals of different processes are aligned to.
+
+namespace {
+
+volatile std::sig_atomic_t stop_requested = 0;
+
+void request_stop(int) {
+    stop_requested = 1;
+}
+
+socklen_t make_address(const std::string& path, sockaddr_un& address) {
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Socket path is too long: " + path);
+    }
+    address = {};
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + path.size() + 1);
+}
+
+int open_socket() {
+    int fd = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        throw std::runtime_error(std::string("Unable to create socket: ") + std::strerror(errno));
+    }
+    return fd;
+}
+
+// Replies go to the querying socket's address, in datagrams small enough
+// for the client's buffer.
+void send_report(int fd, const MetricsCollector& collector, std::string_view prefix, const sockaddr_un& to,
+                 socklen_t to_length) {
+    std::string text;
+    collector.report(text, prefix);
+    constexpr std::size_t CHUNK = METRICS_MAX_DATAGRAM - sizeof(MetricsHeader);
+    std::string datagram;
+    std::uint32_t sequence = 0;
+    std::size_t offset = 0;
+    do {
+        std::size_t n = std::min(CHUNK, text.size() - offset);
+        datagram.clear();
+        put_metrics_header(datagram, MetricsMessage::Report, offset + n < text.size() ? METRICS_FLAG_MORE : 0,
+                           static_cast<std::uint32_t>(::getpid()), sequence++);
+        datagram.append(text, offset, n);
+        offset += n;
+        if (::sendto(fd, datagram.data(), datagram.size(), MSG_DONTWAIT | MSG_NOSIGNAL,
+                     reinterpret_cast<const sockaddr*>(&to), to_length) < 0) {
+            return;
+        }
+    } while (offset < text.size());
+}
+
+void print_summary(const MetricsCollector& collector) {
+    const MetricsCollector::Counters& c = collector.counters();
+    std::string text;
+    collector.report(text);
+    std::cout << text << collector.timerCount() << " timers from " << collector.reporterCount() << " reporters; "
+              << c.datagrams << " datagrams (" << c.bytes << " bytes), " << c.deltas << " deltas, " << c.lost
+              << " lost, " << c.malformed << " malformed" << std::endl;
+}
+
+int run_daemon(const std::string& path, int print_seconds) {
+    sockaddr_un address;
+    socklen_t length = make_address(path, address);
+    int fd = open_socket();
+    // Only replace a leftover socket, never some other file.
+    struct stat st;
+    if (::lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+        ::unlink(path.c_str());
+    }
+    if (::bind(fd, reinterpret_cast<const sockaddr*>(&address), length) != 0) {
+        throw std::runtime_error("Unable to bind " + path + ": " + std::strerror(errno));
+    }
+    // Room for a burst of flushes from many reporters at once.
+    int buffer = 8 << 20;
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer));
+
+    struct sigaction action = {};
+    action.sa_handler = request_stop;
+    ::sigaction(SIGINT, &action, nullptr);
+    ::sigaction(SIGTERM, &action, nullptr);
+
+    MetricsCollector collector;
+    std::vector<std::uint8_t> datagram(METRICS_MAX_DATAGRAM);
+    std::string reply;
+    // Changes with every run, so clients can tell the reference restarted.
+    std::uint64_t reference_id = std::random_device{}() | static_cast<std::uint64_t>(std::random_device{}()) << 32 | 1;
+    auto reference_now = []() { return clock_detail::read_ns(CLOCK_MONOTONIC); };
+    auto next_print = std::chrono::steady_clock::now() + std::chrono::seconds(print_seconds);
+    while (!stop_requested) {
+        int timeout = -1;
+        if (print_seconds > 0) {
+            auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(next_print - std::chrono::steady_clock::now());
+            timeout = static_cast<int>(std::max<std::int64_t>(0, wait.count()));
+        }
+        pollfd pfd{fd, POLLIN, 0};
+        ::poll(&pfd, 1, timeout);
+        while (true) {
+            sockaddr_un from;
+            socklen_t from_length = sizeof(from);
+            ssize_t n = ::recvfrom(fd, datagram.data(), datagram.size(), MSG_DONTWAIT,
+                                   reinterpret_cast<sockaddr*>(&from), &from_length);
+            std::int64_t received_ns = reference_now();
+            if (n < 0) {
+                break;
+            }
+            const std::uint8_t* p = datagram.data();
+            MetricsHeader header;
+            bool ours = read_metrics_header(p, p + n, header);
+            if (ours && header.type == MetricsMessage::SyncRequest) {
+                if (clock_sync_answer(header, p, datagram.data() + n, received_ns, reference_id, reply, reference_now)) {
+                    ::sendto(fd, reply.data(), reply.size(), MSG_DONTWAIT | MSG_NOSIGNAL,
+                             reinterpret_cast<const sockaddr*>(&from), from_length);
+                }
+            } else if (ours && header.type == MetricsMessage::Query) {
+                send_report(fd, collector, std::string_view(reinterpret_cast<const char*>(p), datagram.data() + n - p),
+                            from, from_length);
+            } else {
+                collector.ingest(datagram.data(), static_cast<std::size_t>(n));
+            }
+        }
+        if (print_seconds > 0 && std::chrono::steady_clock::now() >= next_print) {
+            print_summary(collector);
+            next_print += std::chrono::seconds(print_seconds);
+        }
+    }
+    ::close(fd);
+    ::unlink(path.c_str());
+    print_summary(collector);
+    return 0;
+}
+
+int run_query(const std::string& path, const std::string& prefix) {
+    sockaddr_un address;
+    socklen_t length = make_address(path, address);
+    int fd = open_socket();
+    // Autobind to an abstract address so the collector has somewhere to reply.
+    sa_family_t family = AF_UNIX;
+    if (::bind(fd, reinterpret_cast<const sockaddr*>(&family), sizeof(family)) != 0) {
+        throw std::runtime_error(std::string("Unable to bind query socket: ") + std::strerror(errno));
+    }
+    timeval timeout{2, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    std::string query;
+    put_metrics_header(query, MetricsMessage::Query, 0, static_cast<std::uint32_t>(::getpid()), 0);
+    query += prefix;
+    if (::sendto(fd, query.data(), query.size(), 0, reinterpret_cast<const sockaddr*>(&address), length) < 0) {
+        throw std::runtime_error("No collector at " + path + ": " + std::strerror(errno));
+    }
+    std::vector<std::uint8_t> datagram(METRICS_MAX_DATAGRAM);
+    while (true) {
+        ssize_t n = ::recv(fd, datagram.data(), datagram.size(), 0);
+        if (n < 0) {
+            throw std::runtime_error("No reply from collector at " + path);
+        }
+        const std::uint8_t* p = datagram.data();
+        MetricsHeader header;
+        if (!read_metrics_header(p, p + n, header) || header.type != MetricsMessage::Report) {
+            continue;
+        }
+        std::cout.write(reinterpret_cast<const char*>(p), datagram.data() + n - p);
+        if (!(header.flags & METRICS_FLAG_MORE)) {
+            break;
+        }
+    }
+    ::close(fd);
+    return 0;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    std::string path = METRICS_DEFAULT_SOCKET;
+    int print_seconds = 10;
+    bool query = false;
+    std::string prefix;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--socket" && i + 1 < argc) {
+            path = argv[++i];
+        } else if (arg == "--print-interval" && i + 1 < argc) {
+            print_seconds = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--query") {
+            query = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                prefix = argv[++i];
+            }
+        } else {
+            std::cerr << "Usage: stopwatch-collector [--socket PATH] [--print-interval SECONDS] [--query [PREFIX]]"
+                      << std::endl;
+            return 1;
+        }
+    }
+    try {
+        return query ? run_query(path, prefix) : run_daemon(path, print_seconds);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,413 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#endif
+
+#include "status_display.h"
+#include "stopwatch_clock.h"
+#include "time_format.h"
+
+enum class OutputFormat {
+    Text,
+    Csv
+};
+
+struct StopwatchConfig {
+    double display_interval = 1.0;
+    ClockSource clock_source = ClockSource::Steady;
+    ClockDomain clock_domain = ClockDomain::Monotonic;
+    // Laps kept in memory; older laps are dropped once exceeded. 0 keeps all.
+    std::size_t max_laps = 0;
+    OutputFormat output_format = OutputFormat::Text;
+    bool show_progress_bar = true;
+    bool live_display = true;
+    TimeFormat time_format = TimeFormat::MinutesSeconds;
+    // Progress bar target: a duration in seconds or a lap count; with neither
+    // the bar sweeps once a minute.
+    double target_duration = 0.0;
+    std::uint64_t target_laps = 0;
+    ProgressStyle progress_style = ProgressStyle::Ascii;
+    // Record 1 in lap_sample_rate laps; with a budget (fraction of elapsed
+    // time spent recording laps) the rate adapts, starting from this value.
+    std::uint32_t lap_sample_rate = 1;
+    double lap_sample_budget = 0.0;
+
+    bool operator==(const StopwatchConfig&) const = default;
+};
+
+// Snapshot of everything the display thread and output paths read while the
+// stopwatch runs. Never modified after publication; changes swap in a new one.
+struct DisplaySettings {
+    std::chrono::duration<double> interval{1.0};
+    OutputFormat output_format = OutputFormat::Text;
+    bool show_progress_bar = true;
+    bool live_display = true;
+    TimeFormat time_format = TimeFormat::MinutesSeconds;
+    std::int64_t target_ns = 0;
+    std::uint64_t target_laps = 0;
+    ProgressStyle progress_style = ProgressStyle::Ascii;
+};
+
+// Holds the published DisplaySettings. The lock only covers copying the
+// shared_ptr, so readers never wait on a writer building a snapshot, and
+// the old snapshot is released outside it. std::atomic<std::shared_ptr> is
+// not used because libstdc++ 12 drops its internal lock with relaxed
+// ordering after a load, which races with a concurrent store.
+class SettingsSlot {
+private:
+    mutable std::atomic_flag busy;
+    std::shared_ptr<const DisplaySettings> current;
+
+    void lock() const {
+        while (busy.test_and_set(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+    }
+
+    void unlock() const { busy.clear(std::memory_order_release); }
+
+public:
+    explicit SettingsSlot(std::shared_ptr<const DisplaySettings> initial) : current(std::move(initial)) {}
+
+    std::shared_ptr<const DisplaySettings> load() const {
+        lock();
+        std::shared_ptr<const DisplaySettings> copy = current;
+        unlock();
+        return copy;
+    }
+
+    void store(std::shared_ptr<const DisplaySettings> next) {
+        lock();
+        current.swap(next);
+        unlock();
+    }
+};
+
+inline const char* to_string(OutputFormat format) {
+    switch (format) {
+        case OutputFormat::Text: return "text";
+        case OutputFormat::Csv: return "csv";
+    }
+    return "text";
+}
+
+namespace config_detail {
+
+inline std::string_view trim(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t' || s.front() == '\r')) s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t' || s.back() == '\r')) s.remove_suffix(1);
+    return s;
+}
+
+[[noreturn]] inline void fail(std::size_t line, const std::string& message) {
+    throw std::runtime_error("Invalid data in config file (line " + std::to_string(line) + "): " + message);
+}
+
+inline bool parse_bool(std::string_view value, std::size_t line) {
+    if (value == "true" || value == "1" || value == "on") {
+        return true;
+    }
+    if (value == "false" || value == "0" || value == "off") {
+        return false;
+    }
+    fail(line, "expected true or false, got '" + std::string(value) + "'");
+}
+
+template <typename T>
+T parse_number(std::string_view value, std::size_t line) {
+    T result{};
+    auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), result);
+    if (ec != std::errc() || end != value.data() + value.size()) {
+        fail(line, "expected a number, got '" + std::string(value) + "'");
+    }
+    return result;
+}
+
+}
+
+// Parses "key = value" lines; '#' starts a comment. A file holding just a
+// number is the old format and is read as the display interval.
+inline StopwatchConfig parse_config(std::string_view text) {
+    using namespace config_detail;
+    StopwatchConfig config;
+    std::size_t line_number = 0;
+    bool legacy_checked = false;
+    while (!text.empty()) {
+        std::size_t newline = text.find('\n');
+        std::string_view line = text.substr(0, newline);
+        text.remove_prefix(newline == std::string_view::npos ? text.size() : newline + 1);
+        ++line_number;
+
+        std::size_t hash = line.find('#');
+        if (hash != std::string_view::npos) {
+            line = line.substr(0, hash);
+        }
+        line = trim(line);
+        if (line.empty()) {
+            continue;
+        }
+
+        std::size_t equals = line.find('=');
+        if (equals == std::string_view::npos) {
+            if (!legacy_checked) {
+                config.display_interval = parse_number<double>(line, line_number);
+                legacy_checked = true;
+                continue;
+            }
+            fail(line_number, "expected key = value");
+        }
+        legacy_checked = true;
+        std::string_view key = trim(line.substr(0, equals));
+        std::string_view value = trim(line.substr(equals + 1));
+
+        if (key == "display_interval") {
+            config.display_interval = parse_number<double>(value, line_number);
+        } else if (key == "clock_source") {
+            if (!parse_clock_source(value, config.clock_source)) {
+                fail(line_number, "unknown clock_source '" + std::string(value) + "'");
+            }
+        } else if (key == "clock_domain") {
+            if (!parse_clock_domain(value, config.clock_domain)) {
+                fail(line_number, "unknown clock_domain '" + std::string(value) + "'");
+            }
+        } else if (key == "max_laps") {
+            config.max_laps = parse_number<std::size_t>(value, line_number);
+        } else if (key == "output_format") {
+            if (value == "text") {
+                config.output_format = OutputFormat::Text;
+            } else if (value == "csv") {
+                config.output_format = OutputFormat::Csv;
+            } else {
+                fail(line_number, "unknown output_format '" + std::string(value) + "'");
+            }
+        } else if (key == "show_progress_bar") {
+            config.show_progress_bar = parse_bool(value, line_number);
+        } else if (key == "live_display") {
+            config.live_display = parse_bool(value, line_number);
+        } else if (key == "time_format") {
+            if (!parse_time_format(value, config.time_format)) {
+                fail(line_number, "unknown time_format '" + std::string(value) + "'");
+            }
+        } else if (key == "target_duration") {
+            config.target_duration = parse_number<double>(value, line_number);
+        } else if (key == "target_laps") {
+            config.target_laps = parse_number<std::uint64_t>(value, line_number);
+        } else if (key == "progress_style") {
+            if (!parse_progress_style(value, config.progress_style)) {
+                fail(line_number, "unknown progress_style '" + std::string(value) + "'");
+            }
+        } else if (key == "lap_sample_rate") {
+            config.lap_sample_rate = parse_number<std::uint32_t>(value, line_number);
+            if (config.lap_sample_rate == 0) {
+                fail(line_number, "lap_sample_rate must be at least 1");
+            }
+        } else if (key == "lap_sample_budget") {
+            config.lap_sample_budget = parse_number<double>(value, line_number);
+        } else {
+            fail(line_number, "unknown key '" + std::string(key) + "'");
+        }
+    }
+    return config;
+}
+
+inline std::string serialize_config(const StopwatchConfig& config) {
+    char interval[32];
+    auto [end, ec] = std::to_chars(interval, interval + sizeof(interval), config.display_interval);
+    (void)ec;
+    char target[32];
+    auto [target_end, target_ec] = std::to_chars(target, target + sizeof(target), config.target_duration);
+    (void)target_ec;
+    char budget[32];
+    auto [budget_end, budget_ec] = std::to_chars(budget, budget + sizeof(budget), config.lap_sample_budget);
+    (void)budget_ec;
+    std::string text;
+    text += "display_interval = ";
+    text.append(interval, end);
+    text += "\nclock_source = ";
+    text += to_string(config.clock_source);
+    text += "\nclock_domain = ";
+    text += to_string(config.clock_domain);
+    text += "\nmax_laps = ";
+    text += std::to_string(config.max_laps);
+    text += "\noutput_format = ";
+    text += to_string(config.output_format);
+    text += "\nshow_progress_bar = ";
+    text += config.show_progress_bar ? "true" : "false";
+    text += "\nlive_display = ";
+    text += config.live_display ? "true" : "false";
+    text += "\ntime_format = ";
+    text += to_string(config.time_format);
+    text += "\ntarget_duration = ";
+    text.append(target, target_end);
+    text += "\ntarget_laps = ";
+    text += std::to_string(config.target_laps);
+    text += "\nprogress_style = ";
+    text += to_string(config.progress_style);
+    text += "\nlap_sample_rate = ";
+    text += std::to_string(config.lap_sample_rate);
+    text += "\nlap_sample_budget = ";
+    text.append(budget, budget_end);
+    text += "\n";
+    return text;
+}
+
+inline StopwatchConfig load_config_file(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Unable to open config file for reading");
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Unable to open config file for reading");
+    }
+    if (st.st_size == 0) {
+        ::close(fd);
+        throw std::runtime_error("Invalid data in config file");
+    }
+    void* p = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        throw std::runtime_error("Unable to map config file");
+    }
+    try {
+        StopwatchConfig config = parse_config(std::string_view(static_cast<const char*>(p), static_cast<std::size_t>(st.st_size)));
+        ::munmap(p, static_cast<std::size_t>(st.st_size));
+        return config;
+    } catch (...) {
+        ::munmap(p, static_cast<std::size_t>(st.st_size));
+        throw;
+    }
+}
+
+// Writes a private temporary file next to the target and renames it over the
+// target, so concurrent readers and writers only ever see a complete file.
+inline void save_config_file(const std::string& path, const StopwatchConfig& config) {
+    std::string text = serialize_config(config);
+    std::string temp = path + ".tmp." + std::to_string(::getpid());
+    int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Unable to open config file for writing");
+    }
+    const char* data = text.data();
+    std::size_t remaining = text.size();
+    while (remaining > 0) {
+        ssize_t n = ::write(fd, data, remaining);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            ::close(fd);
+            ::unlink(temp.c_str());
+            throw std::runtime_error("Unable to write config file");
+        }
+        data += n;
+        remaining -= static_cast<std::size_t>(n);
+    }
+    if (::fsync(fd) != 0 || ::close(fd) != 0 || ::rename(temp.c_str(), path.c_str()) != 0) {
+        ::unlink(temp.c_str());
+        throw std::runtime_error("Unable to replace config file");
+    }
+}
+
+// Watches the directory holding the config (renames replace the inode, so
+// watching the file itself would stop after the first update) and calls back
+// with the new settings whenever a valid file is written or moved into place.
+class ConfigWatcher {
+private:
+    std::string path;
+    std::function<void(const StopwatchConfig&)> callback;
+    int inotify_fd = -1;
+    int stop_fd = -1;
+    std::thread watcher;
+
+    void run() {
+#ifdef __linux__
+        std::string name = path.substr(path.find_last_of('/') + 1);
+        alignas(inotify_event) char buf[4096];
+        while (true) {
+            pollfd fds[2] = {{inotify_fd, POLLIN, 0}, {stop_fd, POLLIN, 0}};
+            if (::poll(fds, 2, -1) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return;
+            }
+            if (fds[1].revents) {
+                return;
+            }
+            ssize_t n = ::read(inotify_fd, buf, sizeof(buf));
+            bool changed = false;
+            for (ssize_t i = 0; i < n;) {
+                auto* event = reinterpret_cast<inotify_event*>(buf + i);
+                if (event->len > 0 && name == event->name) {
+                    changed = true;
+                }
+                i += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+            }
+            if (changed) {
+                try {
+                    callback(load_config_file(path));
+                } catch (const std::exception&) {
+                    // A half-edited file by hand; wait for the next write.
+                }
+            }
+        }
+#endif
+    }
+
+public:
+    ConfigWatcher(std::string file, std::function<void(const StopwatchConfig&)> on_change)
+        : path(std::move(file)), callback(std::move(on_change)) {
+#ifdef __linux__
+        std::size_t slash = path.find_last_of('/');
+        std::string dir = slash == std::string::npos ? "." : path.substr(0, slash);
+        inotify_fd = ::inotify_init1(IN_CLOEXEC);
+        stop_fd = ::eventfd(0, EFD_CLOEXEC);
+        if (inotify_fd < 0 || stop_fd < 0 || ::inotify_add_watch(inotify_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+            if (inotify_fd >= 0) ::close(inotify_fd);
+            if (stop_fd >= 0) ::close(stop_fd);
+            throw std::runtime_error("Unable to watch config file");
+        }
+        watcher = std::thread([this]() { run(); });
+#else
+        throw std::runtime_error("Config watching is not supported on this platform");
+#endif
+    }
+
+    ~ConfigWatcher() {
+#ifdef __linux__
+        std::uint64_t one = 1;
+        [[maybe_unused]] ssize_t written = ::write(stop_fd, &one, sizeof(one));
+        if (watcher.joinable()) {
+            watcher.join();
+        }
+        ::close(inotify_fd);
+        ::close(stop_fd);
+#endif
+    }
+
+    ConfigWatcher(const ConfigWatcher&) = delete;
+    ConfigWatcher& operator=(const ConfigWatcher&) = delete;
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+
+struct LaneSummary {
+    std::size_t lanes = 0;
+    std::int64_t sum_ns = 0;
+    std::int64_t max_ns = 0;
+    std::size_t critical_lane = 0;
+    double mean_ns = 0.0;
+    // Slowest lane over the mean: 1.0 when the work was perfectly balanced.
+    double imbalance = 0.0;
+};
+
+// Independent timers for parallel segments of one logical operation, e.g.
+// one lane per shard queried concurrently. Each lane is a single 64-bit word
+// on its own cache line: bit 0 says whether it runs, the rest hold either the
+// accumulated time (paused) or a virtual start, now minus the accumulated
+// time (running), in nanoseconds since the set was created. A lane is updated
+// with one CAS and read with one load, so the aggregate views never lock and
+// never see a lane half-way through a transition.
+class StopwatchLanes {
+public:
+    using clock = std::chrono::steady_clock;
+
+private:
+    struct alignas(64) Lane {
+        std::atomic<std::uint64_t> word{0};
+    };
+
+    std::unique_ptr<Lane[]> lanes;
+    std::size_t count;
+    clock::time_point epoch;
+
+    std::uint64_t since_epoch(clock::time_point now) const {
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - epoch).count());
+    }
+
+    static std::int64_t elapsed_of(std::uint64_t word, std::uint64_t now) {
+        std::uint64_t value = word >> 1;
+        if (!(word & 1)) {
+            return static_cast<std::int64_t>(value);
+        }
+        // A reader's clock can trail the writer's by a little.
+        return now > value ? static_cast<std::int64_t>(now - value) : 0;
+    }
+
+    Lane& at(std::size_t lane) const {
+        if (lane >= count) {
+            throw std::out_of_range("Invalid lane");
+        }
+        return lanes[lane];
+    }
+
+public:
+    explicit StopwatchLanes(std::size_t lane_count, clock::time_point created = clock::now())
+        : lanes(new Lane[lane_count]), count(lane_count), epoch(created) {}
+
+    std::size_t size() const { return count; }
+
+    // Returns false if the lane was already running.
+    bool start(std::size_t lane, clock::time_point now = clock::now()) {
+        std::atomic<std::uint64_t>& word = at(lane).word;
+        std::uint64_t t = since_epoch(now);
+        std::uint64_t current = word.load(std::memory_order_acquire);
+        while (!(current & 1)) {
+            std::uint64_t accumulated = current >> 1;
+            std::uint64_t next = ((t > accumulated ? t - accumulated : 0) << 1) | 1;
+            if (word.compare_exchange_weak(current, next, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Returns false if the lane was not running.
+    bool pause(std::size_t lane, clock::time_point now = clock::now()) {
+        std::atomic<std::uint64_t>& word = at(lane).word;
+        std::uint64_t t = since_epoch(now);
+        std::uint64_t current = word.load(std::memory_order_acquire);
+        while (current & 1) {
+            std::uint64_t virtual_start = current >> 1;
+            std::uint64_t next = (t > virtual_start ? t - virtual_start : 0) << 1;
+            if (word.compare_exchange_weak(current, next, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void reset(std::size_t lane) { at(lane).word.store(0, std::memory_order_release); }
+
+    bool running(std::size_t lane) const { return at(lane).word.load(std::memory_order_acquire) & 1; }
+
+    std::int64_t elapsedNs(std::size_t lane, clock::time_point now = clock::now()) const {
+        return elapsed_of(at(lane).word.load(std::memory_order_acquire), since_epoch(now));
+    }
+
+    LaneSummary summary(clock::time_point now = clock::now()) const {
+        LaneSummary s;
+        s.lanes = count;
+        std::uint64_t t = since_epoch(now);
+        for (std::size_t i = 0; i < count; ++i) {
+            std::int64_t elapsed = elapsed_of(lanes[i].word.load(std::memory_order_acquire), t);
+            s.sum_ns += elapsed;
+            if (elapsed > s.max_ns) {
+                s.max_ns = elapsed;
+                s.critical_lane = i;
+            }
+        }
+        if (count > 0) {
+            s.mean_ns = static_cast<double>(s.sum_ns) / static_cast<double>(count);
+            s.imbalance = s.mean_ns > 0.0 ? static_cast<double>(s.max_ns) / s.mean_ns : 0.0;
+        }
+        return s;
+    }
+};
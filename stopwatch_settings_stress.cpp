@@ -0,0 +1,195 @@
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "stopwatch_config.h"
+
+// Stress test for hot-reloaded display settings. Runs a stopwatch binary,
+// normally one built with -fsanitize=thread, in a scratch directory with a
+// fast live display. Interval changes from the menu and rewrites of its
+// config file are then interleaved with start/pause/lap commands, so the
+// display thread keeps picking up new settings snapshots while it ticks.
+// ThreadSanitizer exits with status 66 when it has reported a race, so the
+// test passes only if the stopwatch exits cleanly, confirmed every menu
+// change, saw the reloads and kept rendering frames in every second of the
+// run (otherwise nothing was loading the snapshots being replaced).
+//
+// g++ -std=c++20 -O1 -g -fsanitize=thread "stop watch.cpp" -o stopwatch-tsan -pthread
+// g++ -std=c++20 -O2 stopwatch_settings_stress.cpp -o stopwatch_settings_stress
+// ./stopwatch_settings_stress ./stopwatch-tsan [SECONDS]
+
+extern char** environ;
+
+namespace {
+
+const char* const CONFIG_FILE = "stopwatch_config.txt";
+
+void send(int fd, const std::string& text) {
+    const char* data = text.data();
+    std::size_t remaining = text.size();
+    while (remaining > 0) {
+        ssize_t n = ::write(fd, data, remaining);
+        if (n <= 0) {
+            throw std::runtime_error("Stopwatch stopped reading its input");
+        }
+        data += n;
+        remaining -= static_cast<std::size_t>(n);
+    }
+}
+
+std::string read_file(const char* path) {
+    std::ifstream file(path);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+std::size_t count(const std::string& text, const std::string& needle) {
+    std::size_t n = 0;
+    for (std::size_t at = text.find(needle); at != std::string::npos; at = text.find(needle, at + 1)) {
+        ++n;
+    }
+    return n;
+}
+
+int run(const std::string& binary, int seconds) {
+    char scratch[] = "/tmp/stopwatch-stress-XXXXXX";
+    if (!::mkdtemp(scratch) || ::chdir(scratch) != 0) {
+        throw std::runtime_error("Unable to create a scratch directory");
+    }
+    std::mt19937 rng(12345);
+    StopwatchConfig config;
+    config.display_interval = 0.002;
+    save_config_file(CONFIG_FILE, config);
+
+    int input[2];
+    if (::pipe(input) != 0) {
+        throw std::runtime_error("Unable to create a pipe");
+    }
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, input[0], STDIN_FILENO);
+    posix_spawn_file_actions_addclose(&actions, input[1]);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "output.txt", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    char* args[] = {const_cast<char*>(binary.c_str()), nullptr};
+    pid_t pid;
+    int spawned = ::posix_spawn(&pid, binary.c_str(), &actions, nullptr, args, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    ::close(input[0]);
+    if (spawned != 0) {
+        throw std::runtime_error("Unable to run " + binary + ": " + std::strerror(spawned));
+    }
+
+    const double intervals[] = {0.001, 0.002, 0.005, 0.02, 0.1};
+    const TimeFormat formats[] = {TimeFormat::MinutesSeconds, TimeFormat::HoursMillis, TimeFormat::Auto};
+    const std::string FRAME = "(Running)";
+    std::size_t rewrites = 0;
+    std::size_t changes = 0;
+    std::size_t frames = 0;
+    int stalled_seconds = 0;
+    send(input[1], "1\n");
+    auto window_end = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    auto end = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    while (std::chrono::steady_clock::now() < end) {
+        if (std::chrono::steady_clock::now() >= window_end) {
+            std::size_t total = count(read_file("output.txt"), FRAME);
+            if (total == frames) {
+                ++stalled_seconds;
+            }
+            frames = total;
+            window_end += std::chrono::seconds(1);
+        }
+        switch (rng() % 6) {
+            case 0:
+            case 1: {
+                std::ostringstream command;
+                command << "6\n" << intervals[rng() % 5] << "\n";
+                send(input[1], command.str());
+                ++changes;
+                break;
+            }
+            case 2:
+                config.display_interval = intervals[rng() % 5];
+                config.time_format = formats[rng() % 3];
+                config.output_format = rng() % 2 ? OutputFormat::Text : OutputFormat::Csv;
+                config.show_progress_bar = rng() % 2;
+                save_config_file(CONFIG_FILE, config);
+                ++rewrites;
+                break;
+            case 3:
+                send(input[1], "7\n");
+                break;
+            case 4:
+                send(input[1], "2\n1\n");
+                break;
+            case 5:
+                send(input[1], "8\n");
+                break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    send(input[1], "3\n10\n");
+    ::close(input[1]);
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+
+    std::string output = read_file("output.txt");
+    std::size_t reloads = count(output, "Config reloaded.");
+    std::size_t applied = count(output, "Display interval set to");
+    frames = count(output, FRAME);
+    std::cout << "settings stress: " << changes << " interval changes (" << applied << " applied), " << rewrites
+              << " config rewrites (" << reloads << " reloads seen), " << frames << " frames in " << seconds
+              << " s, output in " << scratch << std::endl;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        std::cerr << "FAILED: stopwatch exited with "
+                  << (WIFEXITED(status) ? "status " + std::to_string(WEXITSTATUS(status))
+                                        : "signal " + std::to_string(WTERMSIG(status)))
+                  << std::endl;
+        return 1;
+    }
+    // Only the menu confirms an interval change; reloads print their own line.
+    if (applied != changes || reloads == 0) {
+        std::cerr << "FAILED: settings changes were not all applied" << std::endl;
+        return 1;
+    }
+    if (stalled_seconds > 0) {
+        std::cerr << "FAILED: no frames were rendered in " << stalled_seconds << " of the " << seconds
+                  << " seconds" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: stopwatch_settings_stress STOPWATCH_BINARY [SECONDS]" << std::endl;
+        return 2;
+    }
+    char binary[PATH_MAX];
+    if (!::realpath(argv[1], binary)) {
+        std::cerr << "No such binary: " << argv[1] << std::endl;
+        return 2;
+    }
+    try {
+        return run(binary, argc > 2 ? std::max(1, std::atoi(argv[2])) : 5);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+enum class RunState : std::uint8_t {
+    Stopped = 0,
+    Running = 1,
+    Paused = 2
+};
+
+enum class StateChange {
+    Started,
+    Resumed,
+    Paused,
+    Stopped,
+    Reset,
+    AlreadyRunning,
+    AlreadyPaused,
+    NotRunning
+};
+
+struct StateSnapshot {
+    RunState state;
+    // Bumped on every transition (mod 256), so two reads with the same
+    // generation saw the same run of the stopwatch.
+    std::uint8_t generation;
+    // Running: virtual start (start tick minus time already accumulated).
+    // Stopped or paused: accumulated time. Both in ns since the epoch.
+    std::uint64_t value;
+
+    std::int64_t elapsedNs(std::uint64_t now_ticks) const {
+        if (state != RunState::Running) {
+            return static_cast<std::int64_t>(value);
+        }
+        return now_ticks > value ? static_cast<std::int64_t>(now_ticks - value) : 0;
+    }
+};
+
+struct StateResult {
+    StateChange change;
+    // Elapsed time at the moment the transition took effect (or was refused).
+    std::int64_t elapsed_ns;
+};
+
+// Stopwatch run state in a single 64-bit word: 2 bits of state, 8 bits of
+// generation and 54 bits of nanoseconds relative to a per-stopwatch epoch
+// (about 208 days of range). Each transition is one CAS, so it is lock-free
+// and takes effect at a single point; readers get state and elapsed time
+// from one load and can never see "running" paired with a stale start.
+// The clock is read just before the CAS, so a thread preempted between the
+// two publishes a time slightly earlier than a reader may already have seen.
+class AtomicStopwatchState {
+public:
+    using clock = std::chrono::steady_clock;
+    static constexpr unsigned STATE_BITS = 2;
+    static constexpr unsigned GENERATION_BITS = 8;
+    static constexpr unsigned VALUE_BITS = 64 - STATE_BITS - GENERATION_BITS;
+    static constexpr std::uint64_t VALUE_MASK = (std::uint64_t(1) << VALUE_BITS) - 1;
+
+private:
+    std::atomic<std::uint64_t> word{0};
+    clock::time_point epoch;
+
+    static std::uint64_t pack(RunState state, unsigned generation, std::uint64_t value) {
+        return static_cast<std::uint64_t>(state) | static_cast<std::uint64_t>(generation & 0xff) << STATE_BITS |
+               (value & VALUE_MASK) << (STATE_BITS + GENERATION_BITS);
+    }
+
+    static StateSnapshot unpack(std::uint64_t w) {
+        return {static_cast<RunState>(w & 3), static_cast<std::uint8_t>(w >> STATE_BITS),
+                w >> (STATE_BITS + GENERATION_BITS)};
+    }
+
+    // decide(snapshot, next) returns the change to report and sets next;
+    // leaving next at the snapshot's own state (other than for a reset)
+    // leaves the word untouched.
+    template <typename Decide>
+    StateResult transition(clock::time_point now, Decide decide) {
+        std::uint64_t t = ticks(now);
+        std::uint64_t current = word.load(std::memory_order_acquire);
+        while (true) {
+            StateSnapshot s = unpack(current);
+            std::int64_t elapsed = s.elapsedNs(t);
+            RunState next = s.state;
+            StateChange change = decide(s, next);
+            if (next == s.state && change != StateChange::Reset) {
+                return {change, elapsed};
+            }
+            std::uint64_t accumulated = change == StateChange::Reset ? 0 : static_cast<std::uint64_t>(elapsed);
+            std::uint64_t value = next == RunState::Running ? (t > accumulated ? t - accumulated : 0) : accumulated;
+            if (word.compare_exchange_weak(current, pack(next, s.generation + 1u, value),
+                                           std::memory_order_acq_rel, std::memory_order_acquire)) {
+                return {change, elapsed};
+            }
+        }
+    }
+
+public:
+    explicit AtomicStopwatchState(clock::time_point created = clock::now()) : epoch(created) {}
+
+    std::uint64_t ticks(clock::time_point now) const {
+        return now > epoch ? static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - epoch).count()) : 0;
+    }
+
+    StateSnapshot load() const { return unpack(word.load(std::memory_order_acquire)); }
+
+    std::int64_t elapsedNs(clock::time_point now = clock::now()) const { return load().elapsedNs(ticks(now)); }
+
+    // Stopped -> Running keeps the time accumulated before the stop, as the
+    // stopwatch always has; only reset() clears it.
+    StateResult start(clock::time_point now = clock::now()) {
+        return transition(now, [](const StateSnapshot& s, RunState& next) {
+            switch (s.state) {
+                case RunState::Running: return StateChange::AlreadyRunning;
+                case RunState::Paused: next = RunState::Running; return StateChange::Resumed;
+                case RunState::Stopped: break;
+            }
+            next = RunState::Running;
+            return StateChange::Started;
+        });
+    }
+
+    StateResult pause(clock::time_point now = clock::now()) {
+        return transition(now, [](const StateSnapshot& s, RunState& next) {
+            switch (s.state) {
+                case RunState::Running: next = RunState::Paused; return StateChange::Paused;
+                case RunState::Paused: return StateChange::AlreadyPaused;
+                case RunState::Stopped: break;
+            }
+            return StateChange::NotRunning;
+        });
+    }
+
+    StateResult stop(clock::time_point now = clock::now()) {
+        return transition(now, [](const StateSnapshot& s, RunState& next) {
+            if (s.state != RunState::Running) {
+                return StateChange::NotRunning;
+            }
+            next = RunState::Stopped;
+            return StateChange::Stopped;
+        });
+    }
+
+    // reset() for a state no other thread can see yet, such as a pooled timer
+    // being handed out: a plain store instead of a CAS and no clock read.
+    void clear() {
+        StateSnapshot s = load();
+        word.store(pack(RunState::Stopped, s.generation + 1u, 0), std::memory_order_release);
+    }
+
+    StateResult reset(clock::time_point now = clock::now()) {
+        return transition(now, [](const StateSnapshot&, RunState& next) {
+            next = RunState::Stopped;
+            return StateChange::Reset;
+        });
+    }
+};
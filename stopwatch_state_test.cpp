@@ -0,0 +1,298 @@
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "stopwatch_state.h"
+
+// Checks AtomicStopwatchState against a plain sequential model.
+//
+// A transition has two steps that other threads can interleave with: the
+// clock read and the CAS that publishes it (a failed CAS retries against
+// the newer word, which is the same as the CAS happening later). Because
+// transitions take the clock reading as a parameter, each interleaving of
+// those steps can be replayed deterministically on one thread. The model
+// check enumerates every interleaving of small per-thread programs and
+// compares each result and the published word with the model. A second
+// phase runs real threads, for ThreadSanitizer and the CAS retry path.
+//
+// g++ -std=c++20 -O2 stopwatch_state_test.cpp -o stopwatch_state_test -pthread
+
+namespace {
+
+enum class Op : std::uint8_t { Start, Pause, Stop, Reset };
+constexpr Op ALL_OPS[] = {Op::Start, Op::Pause, Op::Stop, Op::Reset};
+
+const char* to_string(Op op) {
+    switch (op) {
+        case Op::Start: return "start";
+        case Op::Pause: return "pause";
+        case Op::Stop: return "stop";
+        case Op::Reset: return "reset";
+    }
+    return "?";
+}
+
+// The specification: run state, accumulated time when not running, the
+// virtual start when running, and a generation bumped by every change.
+struct Model {
+    RunState state = RunState::Stopped;
+    std::uint64_t accumulated = 0;
+    std::uint64_t virtual_start = 0;
+    std::uint8_t generation = 0;
+
+    std::int64_t elapsed(std::uint64_t t) const {
+        if (state != RunState::Running) {
+            return static_cast<std::int64_t>(accumulated);
+        }
+        return t > virtual_start ? static_cast<std::int64_t>(t - virtual_start) : 0;
+    }
+
+    void run(std::uint64_t t, std::int64_t elapsed_ns) {
+        auto e = static_cast<std::uint64_t>(elapsed_ns);
+        state = RunState::Running;
+        virtual_start = t > e ? t - e : 0;
+        ++generation;
+    }
+
+    void hold(RunState next, std::uint64_t value) {
+        state = next;
+        accumulated = value;
+        ++generation;
+    }
+
+    StateResult apply(Op op, std::uint64_t t) {
+        std::int64_t e = elapsed(t);
+        switch (op) {
+            case Op::Start:
+                if (state == RunState::Running) {
+                    return {StateChange::AlreadyRunning, e};
+                }
+                {
+                    StateChange change = state == RunState::Paused ? StateChange::Resumed : StateChange::Started;
+                    run(t, e);
+                    return {change, e};
+                }
+            case Op::Pause:
+                if (state == RunState::Paused) {
+                    return {StateChange::AlreadyPaused, e};
+                }
+                if (state == RunState::Stopped) {
+                    return {StateChange::NotRunning, e};
+                }
+                hold(RunState::Paused, static_cast<std::uint64_t>(e));
+                return {StateChange::Paused, e};
+            case Op::Stop:
+                if (state != RunState::Running) {
+                    return {StateChange::NotRunning, e};
+                }
+                hold(RunState::Stopped, static_cast<std::uint64_t>(e));
+                return {StateChange::Stopped, e};
+            case Op::Reset:
+                hold(RunState::Stopped, 0);
+                return {StateChange::Reset, e};
+        }
+        return {StateChange::NotRunning, e};
+    }
+
+    std::uint64_t value() const { return state == RunState::Running ? virtual_start : accumulated; }
+};
+
+StateResult apply(AtomicStopwatchState& state, Op op, AtomicStopwatchState::clock::time_point now) {
+    switch (op) {
+        case Op::Start: return state.start(now);
+        case Op::Pause: return state.pause(now);
+        case Op::Stop: return state.stop(now);
+        case Op::Reset: return state.reset(now);
+    }
+    return {StateChange::NotRunning, 0};
+}
+
+struct Failure {
+    std::string what;
+};
+
+using Program = std::vector<Op>;
+
+class ModelCheck {
+private:
+    const AtomicStopwatchState::clock::time_point epoch{std::chrono::seconds(1)};
+    std::vector<Program> programs;
+    // Each entry is a thread's next step: the first time, it reads the
+    // clock for its next operation; the second, it publishes that operation.
+    std::vector<unsigned> schedule;
+    std::uint64_t interleavings = 0;
+
+    std::string describe() const {
+        std::string text;
+        for (std::size_t t = 0; t < programs.size(); ++t) {
+            text += "thread " + std::to_string(t) + ":";
+            for (Op op : programs[t]) {
+                text += ' ';
+                text += to_string(op);
+            }
+            text += "; ";
+        }
+        text += "schedule:";
+        for (unsigned t : schedule) {
+            text += ' ' + std::to_string(t);
+        }
+        return text;
+    }
+
+    void replay() {
+        ++interleavings;
+        AtomicStopwatchState state(epoch);
+        Model model;
+        std::vector<std::size_t> next(programs.size(), 0);
+        std::vector<std::uint64_t> clock_read(programs.size(), 0);
+        std::vector<bool> has_clock(programs.size(), false);
+        std::uint64_t tick = 0;
+        for (unsigned t : schedule) {
+            if (!has_clock[t]) {
+                // Clock reads are 1 us apart in the order they happen.
+                tick += 1000;
+                clock_read[t] = tick;
+                has_clock[t] = true;
+                continue;
+            }
+            Op op = programs[t][next[t]++];
+            has_clock[t] = false;
+            StateResult got = apply(state, op, epoch + std::chrono::nanoseconds(clock_read[t]));
+            StateResult want = model.apply(op, clock_read[t]);
+            StateSnapshot s = state.load();
+            if (got.change != want.change || got.elapsed_ns != want.elapsed_ns || s.state != model.state ||
+                s.generation != model.generation || s.value != model.value()) {
+                throw Failure{describe() + "; " + to_string(op) + " by thread " + std::to_string(t) +
+                              " differs from the model (elapsed " + std::to_string(got.elapsed_ns) + ", expected " +
+                              std::to_string(want.elapsed_ns) + ")"};
+            }
+            if (got.elapsed_ns < 0) {
+                throw Failure{describe() + ": negative elapsed time"};
+            }
+        }
+    }
+
+    // Every way to merge the threads' step sequences (two steps per op).
+    void interleave(std::vector<std::size_t>& left) {
+        bool done = true;
+        for (std::size_t t = 0; t < programs.size(); ++t) {
+            if (left[t] == 0) {
+                continue;
+            }
+            done = false;
+            --left[t];
+            schedule.push_back(static_cast<unsigned>(t));
+            interleave(left);
+            schedule.pop_back();
+            ++left[t];
+        }
+        if (done) {
+            replay();
+        }
+    }
+
+    // Every assignment of operations to the threads' program slots.
+    void choose(const std::vector<std::size_t>& lengths, std::size_t thread, std::size_t slot) {
+        if (thread == lengths.size()) {
+            std::vector<std::size_t> left;
+            for (std::size_t length : lengths) {
+                left.push_back(2 * length);
+            }
+            interleave(left);
+            return;
+        }
+        if (slot == lengths[thread]) {
+            choose(lengths, thread + 1, 0);
+            return;
+        }
+        for (Op op : ALL_OPS) {
+            programs[thread][slot] = op;
+            choose(lengths, thread, slot + 1);
+        }
+    }
+
+public:
+    // Explores every program with these per-thread lengths under every
+    // interleaving; returns the number of interleavings replayed.
+    std::uint64_t run(const std::vector<std::size_t>& lengths) {
+        programs.assign(lengths.size(), Program());
+        for (std::size_t t = 0; t < lengths.size(); ++t) {
+            programs[t].resize(lengths[t]);
+        }
+        interleavings = 0;
+        choose(lengths, 0, 0);
+        return interleavings;
+    }
+};
+
+// Real threads racing transitions. Every applied change bumps the
+// generation exactly once, so the applied count must match it mod 256, and
+// every word a reader loads must hold a valid state.
+void stress(unsigned threads, unsigned ops_per_thread) {
+    AtomicStopwatchState state;
+    std::atomic<std::uint64_t> applied{0};
+    std::atomic<bool> torn{false};
+    std::vector<std::thread> workers;
+    for (unsigned w = 0; w < threads; ++w) {
+        workers.emplace_back([&, w]() {
+            std::mt19937 rng(w + 1);
+            std::uint64_t mine = 0;
+            for (unsigned i = 0; i < ops_per_thread; ++i) {
+                StateResult r = apply(state, ALL_OPS[rng() % 4], AtomicStopwatchState::clock::now());
+                switch (r.change) {
+                    case StateChange::Started:
+                    case StateChange::Resumed:
+                    case StateChange::Paused:
+                    case StateChange::Stopped:
+                    case StateChange::Reset:
+                        ++mine;
+                        break;
+                    default:
+                        break;
+                }
+                StateSnapshot s = state.load();
+                if (static_cast<unsigned>(s.state) > 2 || s.elapsedNs(state.ticks(AtomicStopwatchState::clock::now())) < 0) {
+                    torn = true;
+                }
+            }
+            applied.fetch_add(mine);
+        });
+    }
+    for (std::thread& t : workers) {
+        t.join();
+    }
+    if (torn) {
+        throw Failure{"stress: a reader saw an invalid state word"};
+    }
+    if (static_cast<std::uint8_t>(applied.load()) != state.load().generation) {
+        throw Failure{"stress: " + std::to_string(applied.load()) + " applied changes but generation " +
+                      std::to_string(state.load().generation)};
+    }
+}
+
+}
+
+int main() {
+    try {
+        ModelCheck check;
+        std::uint64_t total = 0;
+        // Longer single-thread programs for sequences, then every program of
+        // two and three threads under every interleaving of their steps.
+        for (const std::vector<std::size_t>& lengths : std::vector<std::vector<std::size_t>>{{6}, {3, 3}, {2, 2, 1}}) {
+            total += check.run(lengths);
+        }
+        std::cout << "model check: " << total << " interleavings match the model" << std::endl;
+        stress(4, 200000);
+        std::cout << "stress: 4 threads x 200000 transitions, generation consistent" << std::endl;
+    } catch (const Failure& f) {
+        std::cerr << "FAILED: " << f.what << std::endl;
+        return 1;
+    }
+    return 0;
+}
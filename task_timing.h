@@ -0,0 +1,225 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Timing for a logical task that hops between pool threads. The context is a
+// cheap handle that is moved along with the work item; each hop records when
+// it was queued, when a worker picked it up and when it finished, so queue
+// wait and execution time can be separated no matter which thread ran it.
+// Hops are recorded under a per-task mutex, so the task may be inspected
+// (and a CriticalPath built) while it is still hopping between threads; a
+// hop that is still queued or running is counted up to the time of the query.
+struct TaskHop {
+    using clock = std::chrono::steady_clock;
+
+    std::thread::id thread;
+    clock::time_point enqueued;
+    clock::time_point started;
+    clock::time_point finished;
+
+    bool isStarted() const { return started != clock::time_point{}; }
+    bool isFinished() const { return finished != clock::time_point{}; }
+
+    // The last moment this hop accounts for, given the current time.
+    clock::time_point until(clock::time_point now) const {
+        if (isFinished()) {
+            return finished;
+        }
+        return std::max(now, isStarted() ? started : enqueued);
+    }
+
+    std::chrono::duration<double> queueWait(clock::time_point now) const {
+        return (isStarted() ? started : until(now)) - enqueued;
+    }
+
+    std::chrono::duration<double> execution(clock::time_point now) const {
+        if (!isStarted()) {
+            return std::chrono::duration<double>(0);
+        }
+        return until(now) - started;
+    }
+
+    std::chrono::duration<double> queueWait() const { return queueWait(clock::now()); }
+    std::chrono::duration<double> execution() const { return execution(clock::now()); }
+};
+
+class TaskContext {
+private:
+    using clock = std::chrono::steady_clock;
+
+    struct Node {
+        std::string name;
+        clock::time_point created;
+        std::mutex hops_mtx;
+        std::vector<TaskHop> hops;
+        std::mutex children_mtx;
+        std::vector<std::shared_ptr<Node>> children;
+    };
+
+    std::shared_ptr<Node> node;
+
+    explicit TaskContext(std::shared_ptr<Node> n) : node(std::move(n)) {}
+
+    friend struct CriticalPath;
+
+public:
+    TaskContext() = default;
+
+    static TaskContext root(std::string name) {
+        auto n = std::make_shared<Node>();
+        n->name = std::move(name);
+        n->created = clock::now();
+        return TaskContext(std::move(n));
+    }
+
+    TaskContext spawn(std::string name) const {
+        TaskContext child = root(std::move(name));
+        std::lock_guard<std::mutex> lock(node->children_mtx);
+        node->children.push_back(child.node);
+        return child;
+    }
+
+    // Called by the submitting thread right before the task is pushed to a queue.
+    void enqueue() {
+        TaskHop hop;
+        hop.enqueued = clock::now();
+        std::lock_guard<std::mutex> lock(node->hops_mtx);
+        node->hops.push_back(hop);
+    }
+
+    // Called by the worker that dequeued the task.
+    void begin() {
+        auto now = clock::now();
+        std::lock_guard<std::mutex> lock(node->hops_mtx);
+        if (node->hops.empty()) {
+            node->hops.emplace_back().enqueued = now;
+        }
+        TaskHop& hop = node->hops.back();
+        hop.thread = std::this_thread::get_id();
+        hop.started = now;
+    }
+
+    void end() {
+        auto now = clock::now();
+        std::lock_guard<std::mutex> lock(node->hops_mtx);
+        if (!node->hops.empty()) {
+            node->hops.back().finished = now;
+        }
+    }
+
+    const std::string& name() const { return node->name; }
+
+    // A copy, since the task may still be adding hops.
+    std::vector<TaskHop> hops() const {
+        std::lock_guard<std::mutex> lock(node->hops_mtx);
+        return node->hops;
+    }
+
+    // Same shape as Stopwatch laps: cumulative time since the task was created,
+    // sampled at the end of every finished hop.
+    std::vector<std::chrono::duration<double>> laps() const {
+        std::vector<std::chrono::duration<double>> result;
+        for (const TaskHop& hop : hops()) {
+            if (hop.isFinished()) {
+                result.push_back(hop.finished - node->created);
+            }
+        }
+        return result;
+    }
+
+    std::chrono::duration<double> queueWait() const {
+        auto now = clock::now();
+        std::chrono::duration<double> total(0);
+        for (const TaskHop& hop : hops()) {
+            total += hop.queueWait(now);
+        }
+        return total;
+    }
+
+    std::chrono::duration<double> execution() const {
+        auto now = clock::now();
+        std::chrono::duration<double> total(0);
+        for (const TaskHop& hop : hops()) {
+            total += hop.execution(now);
+        }
+        return total;
+    }
+};
+
+struct CriticalPathStep {
+    std::string name;
+    std::size_t hops;
+    std::chrono::duration<double> queue_wait;
+    std::chrono::duration<double> execution;
+};
+
+// Follows, from the root, the child whose subtree finished last; the chain of
+// tasks visited is the one that determined the end-to-end latency. Built
+// mid-flight, hops still queued or running count up to construction time.
+struct CriticalPath {
+    std::vector<CriticalPathStep> steps;
+    std::chrono::duration<double> queue_wait{0};
+    std::chrono::duration<double> execution{0};
+    std::chrono::duration<double> wall{0};
+
+    explicit CriticalPath(const TaskContext& root) {
+        auto now = std::chrono::steady_clock::now();
+        auto node = root.node;
+        auto start = node->created;
+        auto finish = subtreeFinish(node, now);
+        while (node) {
+            TaskContext ctx(node);
+            std::vector<TaskHop> hops = ctx.hops();
+            CriticalPathStep step{ctx.name(), hops.size(), std::chrono::duration<double>(0), std::chrono::duration<double>(0)};
+            for (const TaskHop& hop : hops) {
+                step.queue_wait += hop.queueWait(now);
+                step.execution += hop.execution(now);
+            }
+            steps.push_back(std::move(step));
+            queue_wait += steps.back().queue_wait;
+            execution += steps.back().execution;
+
+            std::shared_ptr<TaskContext::Node> next;
+            std::chrono::steady_clock::time_point next_finish{};
+            {
+                std::lock_guard<std::mutex> lock(node->children_mtx);
+                for (const auto& child : node->children) {
+                    auto child_finish = subtreeFinish(child, now);
+                    if (!next || child_finish > next_finish) {
+                        next = child;
+                        next_finish = child_finish;
+                    }
+                }
+            }
+            node = std::move(next);
+        }
+        wall = finish - start;
+    }
+
+private:
+    static std::chrono::steady_clock::time_point subtreeFinish(const std::shared_ptr<TaskContext::Node>& node,
+                                                               std::chrono::steady_clock::time_point now) {
+        std::chrono::steady_clock::time_point latest = node->created;
+        {
+            std::lock_guard<std::mutex> lock(node->hops_mtx);
+            for (const TaskHop& hop : node->hops) {
+                latest = std::max(latest, hop.until(now));
+            }
+        }
+        std::lock_guard<std::mutex> lock(node->children_mtx);
+        for (const auto& child : node->children) {
+            auto child_finish = subtreeFinish(child, now);
+            if (child_finish > latest) {
+                latest = child_finish;
+            }
+        }
+        return latest;
+    }
+};
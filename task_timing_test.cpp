@@ -0,0 +1,155 @@
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "task_timing.h"
+
+// Checks TaskContext and CriticalPath on tasks that are still in flight:
+// a hop that is queued or running must count up to the time of the query,
+// never as a negative or epoch-sized duration. The last phase inspects
+// tasks while worker threads keep hopping them, for ThreadSanitizer.
+//
+// g++ -std=c++20 -O2 task_timing_test.cpp -o task_timing_test -pthread
+
+namespace {
+
+using namespace std::chrono_literals;
+using seconds = std::chrono::duration<double>;
+
+const auto GAP = 50ms;
+// Anything past this is a default-constructed time_point leaking through.
+const seconds SANE{10.0};
+
+struct Failure {
+    std::string what;
+};
+
+void expect(bool ok, const std::string& what) {
+    if (!ok) {
+        throw Failure{what};
+    }
+}
+
+bool sane(seconds d) {
+    return d >= seconds(0) && d < SANE;
+}
+
+std::string ms(seconds d) {
+    return std::to_string(d.count() * 1000.0) + " ms";
+}
+
+// One hop done, one running, one still queued, checked at each stage.
+void open_hops() {
+    TaskContext task = TaskContext::root("task");
+    task.enqueue();
+    std::this_thread::sleep_for(GAP);
+    expect(task.queueWait() >= GAP && sane(task.queueWait()), "queued: wait " + ms(task.queueWait()));
+    expect(task.execution() == seconds(0), "queued: execution " + ms(task.execution()));
+    expect(task.laps().empty(), "queued: a lap before any hop finished");
+
+    task.begin();
+    std::this_thread::sleep_for(GAP);
+    seconds wait = task.queueWait();
+    expect(wait >= GAP && sane(wait), "running: wait " + ms(wait));
+    expect(task.execution() >= GAP && sane(task.execution()), "running: execution " + ms(task.execution()));
+    task.end();
+    expect(task.laps().size() == 1, "finished: expected one lap");
+
+    task.enqueue();
+    std::this_thread::sleep_for(GAP);
+    expect(task.queueWait() >= wait + GAP && sane(task.queueWait()), "second hop queued: wait " + ms(task.queueWait()));
+    expect(task.execution() < 2 * GAP, "second hop queued: execution " + ms(task.execution()));
+    expect(task.laps().size() == 1, "second hop queued: expected one lap");
+}
+
+// The running child is still setting the latency, so the path ends there.
+void critical_path_mid_flight() {
+    TaskContext root = TaskContext::root("root");
+    root.begin();
+    TaskContext done = root.spawn("done");
+    TaskContext running = root.spawn("running");
+    TaskContext queued = root.spawn("queued");
+    done.begin();
+    done.end();
+    running.begin();
+    root.end();
+    queued.enqueue();
+    std::this_thread::sleep_for(GAP);
+
+    CriticalPath path(root);
+    expect(path.steps.size() == 2, "mid-flight path has " + std::to_string(path.steps.size()) + " steps, expected 2");
+    expect(path.steps.back().name == "running" || path.steps.back().name == "queued",
+           "mid-flight path ends at finished task " + path.steps.back().name);
+    for (const CriticalPathStep& step : path.steps) {
+        expect(sane(step.queue_wait) && sane(step.execution),
+               step.name + ": wait " + ms(step.queue_wait) + ", execution " + ms(step.execution));
+    }
+    expect(path.wall >= GAP && sane(path.wall), "mid-flight wall " + ms(path.wall));
+    expect(sane(path.queue_wait) && sane(path.execution), "mid-flight totals out of range");
+}
+
+// Workers hop tasks while the main thread keeps building paths over them.
+void concurrent_inspection() {
+    TaskContext root = TaskContext::root("root");
+    std::vector<TaskContext> tasks;
+    for (int i = 0; i < 4; ++i) {
+        tasks.push_back(root.spawn("task " + std::to_string(i)));
+    }
+    std::atomic<bool> running{true};
+    std::vector<std::thread> workers;
+    for (TaskContext& task : tasks) {
+        workers.emplace_back([&running, task]() mutable {
+            while (running) {
+                task.enqueue();
+                std::this_thread::yield();
+                task.begin();
+                std::this_thread::yield();
+                task.end();
+            }
+        });
+    }
+    std::size_t paths = 0;
+    try {
+        auto end = std::chrono::steady_clock::now() + 500ms;
+        while (std::chrono::steady_clock::now() < end) {
+            CriticalPath path(root);
+            for (const CriticalPathStep& step : path.steps) {
+                expect(sane(step.queue_wait) && sane(step.execution),
+                       "concurrent: " + step.name + ": wait " + ms(step.queue_wait) + ", execution " + ms(step.execution));
+            }
+            for (const TaskContext& task : tasks) {
+                expect(sane(task.queueWait()) && sane(task.execution()), "concurrent: " + task.name() + " totals out of range");
+            }
+            ++paths;
+        }
+    } catch (...) {
+        running = false;
+        for (std::thread& t : workers) {
+            t.join();
+        }
+        throw;
+    }
+    running = false;
+    for (std::thread& t : workers) {
+        t.join();
+    }
+    std::cout << "concurrent: " << paths << " critical paths built while tasks hopped" << std::endl;
+}
+
+}
+
+int main() {
+    try {
+        open_hops();
+        critical_path_mid_flight();
+        concurrent_inspection();
+        std::cout << "task timing: in-flight hops counted up to the query" << std::endl;
+    } catch (const Failure& f) {
+        std::cerr << "FAILED: " << f.what << std::endl;
+        return 1;
+    }
+    return 0;
+}
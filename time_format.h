@@ -0,0 +1,271 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <string_view>
+
+enum class TimeFormat {
+    MinutesSeconds, // MM:SS.ss, minutes keep counting past 59
+    HoursMillis,    // HH:MM:SS.mmm
+    DaysHours,      // D+HH:MM:SS
+    Micros,         // 1234.567 µs
+    Nanos,          // 1234567 ns
+    Auto            // picks ns, µs, ms, s, MM:SS.mmm, HH:MM:SS.mmm or D+HH:MM:SS by magnitude
+};
+
+// Longest output of format_duration(), including a sign.
+constexpr std::size_t TIME_FORMAT_MAX_CHARS = 32;
+
+inline const char* to_string(TimeFormat format) {
+    switch (format) {
+        case TimeFormat::MinutesSeconds: return "mm:ss";
+        case TimeFormat::HoursMillis: return "hh:mm:ss.mmm";
+        case TimeFormat::DaysHours: return "d+hh:mm:ss";
+        case TimeFormat::Micros: return "us";
+        case TimeFormat::Nanos: return "ns";
+        case TimeFormat::Auto: return "auto";
+    }
+    return "mm:ss";
+}
+
+inline bool parse_time_format(std::string_view name, TimeFormat& format) {
+    for (TimeFormat f : {TimeFormat::MinutesSeconds, TimeFormat::HoursMillis, TimeFormat::DaysHours,
+                         TimeFormat::Micros, TimeFormat::Nanos, TimeFormat::Auto}) {
+        if (name == to_string(f)) {
+            format = f;
+            return true;
+        }
+    }
+    return false;
+}
+
+namespace time_format_detail {
+
+constexpr std::array<char, 200> DIGIT_PAIRS = [] {
+    std::array<char, 200> table{};
+    for (int i = 0; i < 100; ++i) {
+        table[2 * i] = static_cast<char>('0' + i / 10);
+        table[2 * i + 1] = static_cast<char>('0' + i % 10);
+    }
+    return table;
+}();
+
+inline char* put2(char* p, unsigned value) {
+    std::memcpy(p, &DIGIT_PAIRS[2 * value], 2);
+    return p + 2;
+}
+
+inline char* put3(char* p, unsigned value) {
+    *p = static_cast<char>('0' + value / 100);
+    return put2(p + 1, value % 100);
+}
+
+constexpr std::array<std::uint64_t, 20> POWERS_OF_TEN = [] {
+    std::array<std::uint64_t, 20> table{};
+    std::uint64_t v = 1;
+    for (auto& p : table) {
+        p = v;
+        v *= 10;
+    }
+    return table;
+}();
+
+inline unsigned digit_count(std::uint64_t value) {
+    value |= 1;
+    unsigned guess = static_cast<unsigned>(std::bit_width(value)) * 1233 >> 12;
+    return guess + (value >= POWERS_OF_TEN[guess]);
+}
+
+// Exactly eight digits, as two independent 32-bit halves.
+inline char* put8(char* p, std::uint32_t value) {
+    std::uint32_t high = value / 10000;
+    std::uint32_t low = value % 10000;
+    p = put2(p, high / 100);
+    p = put2(p, high % 100);
+    p = put2(p, low / 100);
+    return put2(p, low % 100);
+}
+
+// Values are cut into eight-digit chunks rendered with 32-bit arithmetic.
+// The leading chunk is rendered in full and its leading zeros are shifted
+// out, so there is no per-digit loop to mispredict; it may write up to eight
+// bytes, which the TIME_FORMAT_MAX_CHARS buffer always has room for.
+inline char* put_uint(char* p, std::uint64_t value) {
+    if (value >= 100000000) {
+        std::uint64_t high = value / 100000000;
+        p = put_uint(p, high);
+        return put8(p, static_cast<std::uint32_t>(value - high * 100000000));
+    }
+    unsigned n = digit_count(value);
+    char digits[8];
+    put8(digits, static_cast<std::uint32_t>(value));
+    if constexpr (std::endian::native == std::endian::little) {
+        std::uint64_t word;
+        std::memcpy(&word, digits, sizeof(word));
+        word >>= 8 * (8 - n);
+        std::memcpy(p, &word, sizeof(word));
+    } else {
+        std::memcpy(p, digits + 8 - n, n);
+    }
+    return p + n;
+}
+
+// At least two digits, more when the leading field overflows.
+inline char* put_field(char* p, std::uint64_t value) {
+    return value < 100 ? put2(p, static_cast<unsigned>(value)) : put_uint(p, value);
+}
+
+inline char* put_text(char* p, std::string_view text) {
+    std::memcpy(p, text.data(), text.size());
+    return p + text.size();
+}
+
+// MM:SS.mmm when hours is false, HH:MM:SS.mmm otherwise.
+inline char* put_clock_millis(char* p, std::uint64_t ns, bool hours) {
+    std::uint64_t ms = (ns + 500000) / 1000000;
+    unsigned rem;
+    if (hours) {
+        std::uint64_t h = ms / 3600000;
+        rem = static_cast<unsigned>(ms - h * 3600000);
+        p = put_field(p, h);
+        *p++ = ':';
+        p = put2(p, rem / 60000);
+        rem %= 60000;
+    } else {
+        std::uint64_t m = ms / 60000;
+        rem = static_cast<unsigned>(ms - m * 60000);
+        p = put_field(p, m);
+    }
+    *p++ = ':';
+    p = put2(p, rem / 1000);
+    *p++ = '.';
+    return put3(p, rem % 1000);
+}
+
+inline char* put_days(char* p, std::uint64_t ns) {
+    std::uint64_t s = (ns + 500000000) / 1000000000;
+    std::uint64_t days = s / 86400;
+    unsigned rem = static_cast<unsigned>(s - days * 86400);
+    p = put_uint(p, days);
+    *p++ = '+';
+    p = put2(p, rem / 3600);
+    *p++ = ':';
+    p = put2(p, rem / 60 % 60);
+    *p++ = ':';
+    return put2(p, rem % 60);
+}
+
+// whole.fff followed by unit, truncated to three decimals.
+inline char* put_scaled(char* p, std::uint64_t value, std::uint64_t scale, std::string_view unit) {
+    std::uint64_t whole = value / scale;
+    p = put_uint(p, whole);
+    *p++ = '.';
+    p = put3(p, static_cast<unsigned>((value - whole * scale) / (scale / 1000)));
+    return put_text(p, unit);
+}
+
+}
+
+// Writes the duration into out (at least TIME_FORMAT_MAX_CHARS long) without
+// a terminator and returns the end. Clock-style formats round to their last
+// digit; unit formats truncate.
+inline char* format_duration(char* out, std::int64_t ns, TimeFormat format) {
+    using namespace time_format_detail;
+    char* p = out;
+    std::uint64_t v = static_cast<std::uint64_t>(ns);
+    if (ns < 0) {
+        *p++ = '-';
+        v = 0 - v;
+    }
+    switch (format) {
+        case TimeFormat::MinutesSeconds: {
+            std::uint64_t centis = (v + 5000000) / 10000000;
+            std::uint64_t minutes = centis / 6000;
+            unsigned rem = static_cast<unsigned>(centis - minutes * 6000);
+            p = put_field(p, minutes);
+            *p++ = ':';
+            p = put2(p, rem / 100);
+            *p++ = '.';
+            return put2(p, rem % 100);
+        }
+        case TimeFormat::HoursMillis:
+            return put_clock_millis(p, v, true);
+        case TimeFormat::DaysHours:
+            return put_days(p, v);
+        case TimeFormat::Micros:
+            return put_scaled(p, v, 1000, " \xC2\xB5s");
+        case TimeFormat::Nanos:
+            return put_text(put_uint(p, v), " ns");
+        case TimeFormat::Auto:
+            if (v < 1000) {
+                return put_text(put_uint(p, v), " ns");
+            }
+            if (v < 1000000) {
+                return put_scaled(p, v, 1000, " \xC2\xB5s");
+            }
+            if (v < 1000000000) {
+                return put_scaled(p, v, 1000000, " ms");
+            }
+            if (v < 60000000000ull) {
+                return put_scaled(p, v, 1000000000, " s");
+            }
+            if (v < 3600000000000ull) {
+                return put_clock_millis(p, v, false);
+            }
+            if (v < 86400000000000ull) {
+                return put_clock_millis(p, v, true);
+            }
+            return put_days(p, v);
+    }
+    return p;
+}
+
+inline void append_duration(std::string& out, std::int64_t ns, TimeFormat format) {
+    char buf[TIME_FORMAT_MAX_CHARS];
+    out.append(buf, format_duration(buf, ns, format));
+}
+
+// CLOCK_REALTIME nanoseconds as YYYY-MM-DDTHH:MM:SS.uuuuuuZ.
+inline void append_utc_timestamp(std::string& out, std::int64_t realtime_ns) {
+    using namespace time_format_detail;
+    std::int64_t seconds = realtime_ns / 1000000000;
+    std::int64_t sub = realtime_ns % 1000000000;
+    if (sub < 0) {
+        sub += 1000000000;
+        --seconds;
+    }
+    std::time_t t = static_cast<std::time_t>(seconds);
+    std::tm tm;
+    ::gmtime_r(&t, &tm);
+    char buf[TIME_FORMAT_MAX_CHARS];
+    char* p = put_uint(buf, static_cast<std::uint64_t>(tm.tm_year + 1900));
+    *p++ = '-';
+    p = put2(p, static_cast<unsigned>(tm.tm_mon + 1));
+    *p++ = '-';
+    p = put2(p, static_cast<unsigned>(tm.tm_mday));
+    *p++ = 'T';
+    p = put2(p, static_cast<unsigned>(tm.tm_hour));
+    *p++ = ':';
+    p = put2(p, static_cast<unsigned>(tm.tm_min));
+    *p++ = ':';
+    p = put2(p, static_cast<unsigned>(tm.tm_sec));
+    *p++ = '.';
+    unsigned micros = static_cast<unsigned>(sub / 1000);
+    p = put3(p, micros / 1000);
+    p = put3(p, micros % 1000);
+    *p++ = 'Z';
+    out.append(buf, p);
+}
+
+inline std::int64_t seconds_to_ns(double seconds) {
+    return std::llround(seconds * 1e9);
+}
+
+inline double ns_to_seconds(std::int64_t ns) {
+    return static_cast<double>(ns) * 1e-9;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+
+#include "stopwatch_state.h"
+
+// Refers to a pooled timer. The generation changes every time the slot is
+// acquired or released, so a handle kept after release() stops working
+// instead of silently timing someone else's request.
+struct TimerHandle {
+    std::uint32_t index = 0;
+    std::uint32_t generation = 0;
+};
+
+// Fixed pool of reusable timers for short-lived measurements (one per
+// request), so nothing is allocated, locked or spawned per timer once the
+// pool exists. Free slots form a Treiber stack whose head carries a tag that
+// changes on every update, which rules out ABA when a slot is popped and
+// pushed back between another thread's read and CAS. Each timer counts ticks
+// from the pool's creation (see AtomicStopwatchState for the range).
+class TimerPool {
+private:
+    struct alignas(64) Slot {
+        AtomicStopwatchState state;
+        // Odd while the slot is handed out, even while it is free.
+        std::atomic<std::uint32_t> generation{0};
+        std::atomic<std::uint32_t> next_free{0};
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    std::size_t count;
+    // Low 32 bits: index + 1 of the top free slot (0 when empty). High 32
+    // bits: tag bumped by every push and pop.
+    alignas(64) std::atomic<std::uint64_t> free_head{0};
+
+    static std::uint64_t head(std::uint64_t tag, std::uint32_t top) { return tag << 32 | top; }
+
+    void push(std::uint32_t index) {
+        std::uint64_t current = free_head.load(std::memory_order_relaxed);
+        while (true) {
+            slots[index].next_free.store(static_cast<std::uint32_t>(current), std::memory_order_relaxed);
+            if (free_head.compare_exchange_weak(current, head((current >> 32) + 1, index + 1),
+                                                std::memory_order_release, std::memory_order_relaxed)) {
+                return;
+            }
+        }
+    }
+
+    bool pop(std::uint32_t& index) {
+        std::uint64_t current = free_head.load(std::memory_order_acquire);
+        while (true) {
+            std::uint32_t top = static_cast<std::uint32_t>(current);
+            if (top == 0) {
+                return false;
+            }
+            // May read a slot that another thread has just popped; the tag
+            // makes the CAS below fail in that case.
+            std::uint32_t next = slots[top - 1].next_free.load(std::memory_order_relaxed);
+            if (free_head.compare_exchange_weak(current, head((current >> 32) + 1, next),
+                                                std::memory_order_acquire, std::memory_order_acquire)) {
+                index = top - 1;
+                return true;
+            }
+        }
+    }
+
+    Slot* live(TimerHandle handle) const {
+        if (handle.index >= count) {
+            return nullptr;
+        }
+        Slot& slot = slots[handle.index];
+        return slot.generation.load(std::memory_order_acquire) == handle.generation && (handle.generation & 1) ? &slot : nullptr;
+    }
+
+public:
+    explicit TimerPool(std::size_t capacity) : slots(new Slot[capacity]), count(capacity) {
+        if (capacity > UINT32_MAX - 1) {
+            throw std::length_error("Timer pool too large");
+        }
+        for (std::size_t i = capacity; i > 0; --i) {
+            push(static_cast<std::uint32_t>(i - 1));
+        }
+    }
+
+    TimerPool(const TimerPool&) = delete;
+    TimerPool& operator=(const TimerPool&) = delete;
+
+    std::size_t capacity() const { return count; }
+
+    // Hands out a stopped, zeroed timer; false when every timer is in use.
+    bool acquire(TimerHandle& handle) {
+        std::uint32_t index;
+        if (!pop(index)) {
+            return false;
+        }
+        // The slot is ours alone until the handle is returned, so plain
+        // stores will do.
+        Slot& slot = slots[index];
+        slot.state.clear();
+        std::uint32_t generation = slot.generation.load(std::memory_order_relaxed) + 1;
+        slot.generation.store(generation, std::memory_order_release);
+        handle = {index, generation};
+        return true;
+    }
+
+    // False for a stale handle, including a second release of the same one.
+    bool release(TimerHandle handle) {
+        if (handle.index >= count || !(handle.generation & 1)) {
+            return false;
+        }
+        std::uint32_t expected = handle.generation;
+        if (!slots[handle.index].generation.compare_exchange_strong(expected, expected + 1, std::memory_order_acq_rel)) {
+            return false;
+        }
+        push(handle.index);
+        return true;
+    }
+
+    bool valid(TimerHandle handle) const { return live(handle) != nullptr; }
+
+    // Null for a stale handle. The pointer is only good until release().
+    AtomicStopwatchState* get(TimerHandle handle) const {
+        Slot* slot = live(handle);
+        return slot ? &slot->state : nullptr;
+    }
+};
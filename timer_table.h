@@ -0,0 +1,188 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+
+// Struct-of-arrays timers for very large counts (one per connection, say),
+// where a Stopwatch with its mutex, thread and lap list per timer is far too
+// heavy. A timer is three parallel entries: a start tick, the accumulated
+// ticks and a running flag, 17 bytes in all. Ticks are nanoseconds since the
+// table was created.
+//
+// The batch operations are written branch-free over contiguous arrays and
+// walked in fixed blocks, which the compiler turns into SIMD loops even at
+// -O2; the scalar and index-list forms are there for the odd timer that
+// changes on its own.
+class TimerTable {
+public:
+    using clock = std::chrono::steady_clock;
+    static constexpr std::size_t BYTES_PER_TIMER = 2 * sizeof(std::int64_t) + sizeof(std::uint8_t);
+
+private:
+    std::unique_ptr<std::int64_t[]> starts;
+    std::unique_ptr<std::int64_t[]> accumulated;
+    std::unique_ptr<std::uint8_t[]> running;
+    std::size_t count;
+    clock::time_point epoch;
+
+    // Batch kernels. Full blocks have a constant trip count, which is what
+    // gets them vectorized; the remainder runs as a plain loop. The arrays
+    // come in as restrict parameters because that is where the compiler
+    // honours the no-aliasing promise.
+    static constexpr std::size_t BLOCK = 16;
+
+    static void startBatch(std::int64_t* __restrict s, std::uint8_t* __restrict r, std::size_t n, std::int64_t now) {
+        std::size_t k = 0;
+        for (; k + BLOCK <= n; k += BLOCK) {
+            for (std::size_t j = k; j < k + BLOCK; ++j) {
+                std::int64_t keep = -static_cast<std::int64_t>(r[j]);
+                s[j] = (s[j] & keep) | (now & ~keep);
+                r[j] = 1;
+            }
+        }
+        for (; k < n; ++k) {
+            if (!r[k]) {
+                s[k] = now;
+                r[k] = 1;
+            }
+        }
+    }
+
+    static void pauseBatch(const std::int64_t* __restrict s, std::int64_t* __restrict a, std::uint8_t* __restrict r,
+                           std::size_t n, std::int64_t now) {
+        std::size_t k = 0;
+        for (; k + BLOCK <= n; k += BLOCK) {
+            for (std::size_t j = k; j < k + BLOCK; ++j) {
+                std::int64_t mask = -static_cast<std::int64_t>(r[j]);
+                a[j] += (now - s[j]) & mask;
+                r[j] = 0;
+            }
+        }
+        for (; k < n; ++k) {
+            if (r[k]) {
+                a[k] += now - s[k];
+                r[k] = 0;
+            }
+        }
+    }
+
+    static void elapsedBatch(const std::int64_t* __restrict s, const std::int64_t* __restrict a,
+                             const std::uint8_t* __restrict r, std::size_t n, std::int64_t now,
+                             std::int64_t* __restrict out) {
+        std::size_t k = 0;
+        for (; k + BLOCK <= n; k += BLOCK) {
+            for (std::size_t j = k; j < k + BLOCK; ++j) {
+                std::int64_t mask = -static_cast<std::int64_t>(r[j]);
+                out[j] = a[j] + ((now - s[j]) & mask);
+            }
+        }
+        for (; k < n; ++k) {
+            out[k] = a[k] + (r[k] ? now - s[k] : 0);
+        }
+    }
+
+    static std::int64_t sumBatch(const std::int64_t* __restrict s, const std::int64_t* __restrict a,
+                                 const std::uint8_t* __restrict r, std::size_t n, std::int64_t now) {
+        std::int64_t total = 0;
+        std::size_t k = 0;
+        for (; k + BLOCK <= n; k += BLOCK) {
+            for (std::size_t j = k; j < k + BLOCK; ++j) {
+                std::int64_t mask = -static_cast<std::int64_t>(r[j]);
+                total += a[j] + ((now - s[j]) & mask);
+            }
+        }
+        for (; k < n; ++k) {
+            total += a[k] + (r[k] ? now - s[k] : 0);
+        }
+        return total;
+    }
+
+    void check(std::size_t first, std::size_t n) const {
+        if (first > count || n > count - first) {
+            throw std::out_of_range("Invalid timer range");
+        }
+    }
+
+public:
+    explicit TimerTable(std::size_t timers, clock::time_point created = clock::now())
+        : starts(new std::int64_t[timers]()), accumulated(new std::int64_t[timers]()),
+          running(new std::uint8_t[timers]()), count(timers), epoch(created) {}
+
+    std::size_t size() const { return count; }
+
+    std::int64_t ticks(clock::time_point now = clock::now()) const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(now - epoch).count();
+    }
+
+    void start(std::size_t i, std::int64_t now) {
+        check(i, 1);
+        if (!running[i]) {
+            starts[i] = now;
+            running[i] = 1;
+        }
+    }
+
+    void pause(std::size_t i, std::int64_t now) {
+        check(i, 1);
+        if (running[i]) {
+            accumulated[i] += now - starts[i];
+            running[i] = 0;
+        }
+    }
+
+    void reset(std::size_t i) {
+        check(i, 1);
+        accumulated[i] = 0;
+        running[i] = 0;
+    }
+
+    bool isRunning(std::size_t i) const {
+        check(i, 1);
+        return running[i] != 0;
+    }
+
+    std::int64_t elapsed(std::size_t i, std::int64_t now) const {
+        check(i, 1);
+        return accumulated[i] + (running[i] ? now - starts[i] : 0);
+    }
+
+    // Index-list forms for timers scattered across the table.
+    void startMany(const std::uint32_t* indices, std::size_t n, std::int64_t now) {
+        for (std::size_t k = 0; k < n; ++k) {
+            start(indices[k], now);
+        }
+    }
+
+    void pauseMany(const std::uint32_t* indices, std::size_t n, std::int64_t now) {
+        for (std::size_t k = 0; k < n; ++k) {
+            pause(indices[k], now);
+        }
+    }
+
+    // Contiguous forms. Already running (or paused) timers are left as they
+    // are, without a branch per timer.
+    void startRange(std::size_t first, std::size_t n, std::int64_t now) {
+        check(first, n);
+        startBatch(starts.get() + first, running.get() + first, n, now);
+    }
+
+    void pauseRange(std::size_t first, std::size_t n, std::int64_t now) {
+        check(first, n);
+        pauseBatch(starts.get() + first, accumulated.get() + first, running.get() + first, n, now);
+    }
+
+    void elapsedRange(std::size_t first, std::size_t n, std::int64_t now, std::int64_t* out) const {
+        check(first, n);
+        elapsedBatch(starts.get() + first, accumulated.get() + first, running.get() + first, n, now, out);
+    }
+
+    void elapsedAll(std::int64_t now, std::int64_t* out) const { elapsedRange(0, count, now, out); }
+
+    // Sum of all elapsed times, e.g. busy time across every connection.
+    std::int64_t totalElapsed(std::int64_t now) const {
+        return sumBatch(starts.get(), accumulated.get(), running.get(), count, now);
+    }
+};